@@ -0,0 +1,142 @@
+/*
+ * Author Jerry Lundström <jerry@dns-oarc.net>
+ * Copyright (c) 2017, OARC, Inc.
+ * All rights reserved.
+ *
+ * This file is part of parseconf.
+ *
+ * parseconf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * parseconf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Generate a deterministic config for the benchmarks, the syntax is the one
+ * in parsebench.c
+ */
+
+static unsigned long long seed = 1;
+
+static unsigned long rnd(unsigned long max)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned long)(seed >> 33) % max;
+}
+
+static const char* words[] = {
+    "eth0", "eth1", "lo", "bond0", "example.com", "example.net", "example.org",
+    "internal", "external", "default", "host-10-0-0-1", "fe80::1"
+};
+#define WORD words[rnd(sizeof(words) / sizeof(*words))]
+
+static void usage(void)
+{
+    printf(
+        "usage: confgen [options]\n"
+        " -l <lines>         number of lines to generate (default 100000)\n"
+        " -s <seed>          seed for the generator (default 1)\n"
+        " -h                 this\n");
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long lines = 100000, line, n, i;
+    int           opt;
+
+    while ((opt = getopt(argc, argv, "l:s:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            lines = strtoul(optarg, 0, 10);
+            break;
+        case 's':
+            seed = strtoull(optarg, 0, 10);
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    for (line = 0; line < lines; line++) {
+        switch (rnd(16)) {
+        case 0:
+            printf("# comment %lu for %s\n", line, WORD);
+            break;
+        case 1:
+            printf("\n");
+            break;
+        case 2:
+        case 3:
+            printf("listen %s %lu;\n", WORD, rnd(65536));
+            break;
+        case 4:
+        case 5:
+            printf("allow");
+            for (n = rnd(32) + 1, i = 0; i < n; i++) {
+                printf(" %s", WORD);
+            }
+            printf(";\n");
+            break;
+        case 6:
+            printf("ports");
+            for (n = rnd(48) + 1, i = 0; i < n; i++) {
+                printf(" %lu", rnd(65536));
+            }
+            printf(";\n");
+            break;
+        case 7:
+            printf("weights");
+            for (n = rnd(16) + 1, i = 0; i < n; i++) {
+                printf(" %lu.%lu", rnd(1000), rnd(1000000));
+            }
+            printf(";\n");
+            break;
+        case 8:
+            printf("path \"/var/lib/%s/data %lu\";\n", WORD, rnd(100));
+            break;
+        case 9:
+            printf("timeout %lu; retries %lu;\n", rnd(100000), rnd(10));
+            break;
+        case 10:
+            printf("view %s zone \"%s\";\n", WORD, WORD);
+            break;
+        case 11:
+            printf("view %s allow", WORD);
+            for (n = rnd(8) + 1, i = 0; i < n; i++) {
+                printf(" %s", WORD);
+            }
+            printf("; # view acl\n");
+            break;
+        case 12:
+            printf("view %s timeout %lu;\n", WORD, rnd(100000));
+            break;
+        case 13:
+            printf("  option\t%s  %lu ;\n", WORD, rnd(1000000000));
+            break;
+        case 14:
+            printf("ratio %lu.%lu;\n", rnd(100), rnd(100000));
+            break;
+        default:
+            printf("option %s \"%s %s\";\n", WORD, WORD, WORD);
+            break;
+        }
+    }
+
+    return 0;
+}
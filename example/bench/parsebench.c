@@ -0,0 +1,429 @@
+/*
+ * Author Jerry Lundström <jerry@dns-oarc.net>
+ * Copyright (c) 2017, OARC, Inc.
+ * All rights reserved.
+ *
+ * This file is part of parseconf.
+ *
+ * parseconf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * parseconf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+/*
+ * The parser is included to be able to benchmark its internal functions
+ */
+#include "parseconf.c"
+#include "parsebench-syntax.h"
+
+#include <time.h>
+
+static void usage(void)
+{
+    printf(
+        "usage: parsebench [options] <config>\n"
+        " -n <rounds>        number of rounds for each benchmark, best is reported (default 5)\n"
+        " -p <threads>       number of threads for the parallel benchmark (default all cpus)\n"
+        " -c <cache>         cache file for the cache benchmark (default <config>.cache)\n"
+        " -h                 this\n");
+}
+
+static size_t rounds = 5, threads = 0;
+
+/*
+ * Config
+ */
+
+static volatile unsigned long long checksum;
+
+int touch(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    for (; tokens->type != PARSECONF_TOKEN_END; tokens++) {
+        checksum += tokens->length;
+    }
+    return 0;
+}
+
+static parseconf_token_type_t tokens_listen[]  = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_NUMBER, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_strings[] = { PARSECONF_TOKEN_STRINGS, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_numbers[] = { PARSECONF_TOKEN_NUMBERS, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_floats[]  = { PARSECONF_TOKEN_FLOATS, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_qstring[] = { PARSECONF_TOKEN_QSTRING, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_number[]  = { PARSECONF_TOKEN_NUMBER, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_float[]   = { PARSECONF_TOKEN_FLOAT, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_view[]    = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_NESTED, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_option[]  = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_ANY, PARSECONF_TOKEN_END };
+
+static parseconf_syntax_t view_syntax[] = {
+    { "zone", touch, tokens_qstring, 0, 0, 0, 0 },
+    { "allow", touch, tokens_strings, 0, 0, 0, 0 },
+    { "timeout", touch, tokens_number, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static parseconf_syntax_t syntax[] = {
+    { "listen", touch, tokens_listen, 0, 0, 0, 0 },
+    { "allow", touch, tokens_strings, 0, 0, 0, 0 },
+    { "ports", touch, tokens_numbers, 0, 0, 0, 0 },
+    { "weights", touch, tokens_floats, 0, 0, 0, 0 },
+    { "path", touch, tokens_qstring, 0, 0, 0, 0 },
+    { "timeout", touch, tokens_number, 0, 0, 0, 0 },
+    { "retries", touch, tokens_number, 0, 0, 0, 0 },
+    { "view", 0, tokens_view, view_syntax, 0, 0, 0 },
+    { "option", touch, tokens_option, 0, 0, 0, 0 },
+    { "ratio", touch, tokens_float, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static void error_callback(void* user, parseconf_error_t error, size_t line, size_t token, const parseconf_token_t* tokens, const char* errstr)
+{
+    fprintf(stderr, "parsebench: conf error %d at line %lu token %lu %s\n", error, line, token, errstr ? errstr : "");
+    exit(1);
+}
+
+/*
+ * Timing and reporting
+ */
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, double elapsed, size_t bytes, size_t lines, size_t ops)
+{
+    printf("%-30s %10.3f ms", name, elapsed * 1e3);
+    if (bytes) {
+        printf(" %10.1f MB/s", bytes / elapsed / 1e6);
+    } else {
+        printf(" %15s", "");
+    }
+    if (lines) {
+        printf(" %12.0f lines/s", lines / elapsed);
+    } else {
+        printf(" %18s", "");
+    }
+    printf(" %10.1f ns/op\n", elapsed * 1e9 / ops);
+}
+
+#define BENCH(name, bytes, lines, ops, ...)          \
+    do {                                             \
+        double best = 0, start, elapsed;             \
+        size_t round;                                \
+        for (round = 0; round < rounds; round++) {   \
+            start = now();                           \
+            __VA_ARGS__;                             \
+            elapsed = now() - start;                 \
+            if (!round || elapsed < best)            \
+                best = elapsed;                      \
+        }                                            \
+        report(name, best, bytes, lines, ops);       \
+    } while (0)
+
+/*
+ * Benchmarks
+ */
+
+static char*  conf;
+static size_t conf_size, conf_lines;
+
+static size_t bench_tokenize(void)
+{
+    const char*       buf = conf;
+    size_t            s   = conf_size, n = 0;
+    parseconf_token_t token;
+    int               ret;
+
+    while (s) {
+        for (; s && (*buf == ' ' || *buf == '\t' || *buf == '\n' || *buf == '\r'); buf++, s--)
+            ;
+        if (!s) {
+            break;
+        }
+        ret = parse_token(&buf, &s, &token, 0);
+        if (ret == PARSECONF_OK || ret == PARSECONF_LAST) {
+            n++;
+            continue;
+        }
+        for (; s && *buf != '\n'; buf++, s--)
+            ;
+    }
+
+    return n;
+}
+
+static void bench_values(void)
+{
+    parseconf_token_t      tokens[4096], floats[4096], wide[4096];
+    uint64_t               u64s[4096];
+    double                 doubles[4096];
+    unsigned long int      ul  = 0;
+    unsigned long long int ull = 0;
+    int64_t                i64 = 0;
+    uint32_t               u32 = 0;
+    uint16_t               u16 = 0;
+    double                 d   = 0;
+    long double            ld  = 0;
+    char                   buf[4096 * 33], *p = buf;
+    size_t                 i, n = sizeof(tokens) / sizeof(*tokens);
+
+    for (i = 0; i < n; i++) {
+        tokens[i].type   = PARSECONF_TOKEN_NUMBER;
+        tokens[i].token  = p;
+        tokens[i].length = sprintf(p, "%lu", (unsigned long)(i * 2654435761UL % 65536));
+        p += tokens[i].length + 1;
+        floats[i].type   = PARSECONF_TOKEN_FLOAT;
+        floats[i].token  = p;
+        floats[i].length = sprintf(p, "%lu.%lu", (unsigned long)(i % 1000), (unsigned long)(i * 7919 % 1000000));
+        p += floats[i].length + 1;
+        wide[i].type   = PARSECONF_TOKEN_NUMBER;
+        wide[i].token  = p;
+        wide[i].length = sprintf(p, "%08lu", (unsigned long)(i * 2654435761UL % 100000000));
+        p += wide[i].length + 1;
+    }
+
+    BENCH("parseconf_ulongint", 0, 0, n, for (i = 0; i < n; i++) { parseconf_ulongint(&tokens[i], &ul, 0); checksum += ul; });
+    BENCH("parseconf_ulonglongint", 0, 0, n, for (i = 0; i < n; i++) { parseconf_ulonglongint(&tokens[i], &ull, 0); checksum += ull; });
+    BENCH("parseconf_int64", 0, 0, n, for (i = 0; i < n; i++) { parseconf_int64(&tokens[i], &i64, 0); checksum += i64; });
+    BENCH("parseconf_uint32", 0, 0, n, for (i = 0; i < n; i++) { parseconf_uint32(&tokens[i], &u32, 0); checksum += u32; });
+    BENCH("parseconf_uint16", 0, 0, n, for (i = 0; i < n; i++) { parseconf_uint16(&tokens[i], &u16, 0); checksum += u16; });
+    BENCH("parseconf_double", 0, 0, n, for (i = 0; i < n; i++) { parseconf_double(&floats[i], &d, 0); checksum += d; });
+    BENCH("parseconf_longdouble", 0, 0, n, for (i = 0; i < n; i++) { parseconf_longdouble(&floats[i], &ld, 0); checksum += ld; });
+    BENCH("parseconf_numbers_u64", 0, 0, n, { parseconf_numbers_u64(tokens, 0, u64s, n, 0, 0); checksum += u64s[n - 1]; });
+    BENCH("parseconf_numbers_u64 8 digits", 0, 0, n, { parseconf_numbers_u64(wide, 0, u64s, n, 0, 0); checksum += u64s[n - 1]; });
+    BENCH("parseconf_ulonglongint 8 digits", 0, 0, n, for (i = 0; i < n; i++) { parseconf_ulonglongint(&wide[i], &ull, 0); checksum += ull; });
+    BENCH("parseconf_numbers_double", 0, 0, n, { parseconf_numbers_double(floats, 0, doubles, n, 0, 0); checksum += doubles[n - 1]; });
+}
+
+static void bench_addresses(void)
+{
+    parseconf_token_t tokens[4096], token;
+    char              buf[4096 * 48], *p = buf;
+    size_t            i, n = sizeof(tokens) / sizeof(*tokens);
+
+    for (i = 0; i < n; i++) {
+        tokens[i].type  = PARSECONF_TOKEN_STRING;
+        tokens[i].token = p;
+        if (i & 1) {
+            tokens[i].length = sprintf(p, "2001:db8:%lx::%lx/%lu", (unsigned long)(i * 7919 % 65536), (unsigned long)i, (unsigned long)(i % 129));
+        } else {
+            tokens[i].length = sprintf(p, "10.%lu.%lu.%lu/%lu", (unsigned long)(i >> 8 & 255), (unsigned long)(i & 255), (unsigned long)(i * 31 % 256), (unsigned long)(i % 33));
+        }
+        p += tokens[i].length + 1;
+    }
+
+    BENCH("parse_address", 0, 0, n, for (i = 0; i < n; i++) { token = tokens[i]; parse_address(&token); checksum += token.prefix; });
+}
+
+static void bench_units(void)
+{
+    static const char* suffixes[] = { "ns", "ms", "s", "m", "h", "k", "M", "GB" };
+    parseconf_token_t  tokens[4096], token;
+    char               buf[4096 * 16], *p = buf;
+    size_t             i, n = sizeof(tokens) / sizeof(*tokens);
+
+    for (i = 0; i < n; i++) {
+        tokens[i].type   = PARSECONF_TOKEN_STRING;
+        tokens[i].token  = p;
+        tokens[i].length = sprintf(p, "%lu%s", (unsigned long)(i * 2654435761UL % 100000), suffixes[i % 8]);
+        p += tokens[i].length + 1;
+    }
+
+    BENCH("parse_unit", 0, 0, n, for (i = 0; i < n; i++) { token = tokens[i]; parse_unit(&token, SYNTAX_DURATION | SYNTAX_SIZE); checksum += token.data.value; });
+}
+
+int main(int argc, char** argv)
+{
+    const char*      file;
+    const char*      cache     = 0;
+    char*            cache_buf = 0;
+    FILE*            fp;
+    int              opt;
+    size_t           n, statements = 0, tokens;
+    syntax_level_t*  levels;
+    parser_t         parser;
+    parse_record_t   record;
+    parseconf_ctx_t* ctx;
+
+    while ((opt = getopt(argc, argv, "n:p:c:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            rounds = strtoul(optarg, 0, 10);
+            break;
+        case 'p':
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 'c':
+            cache = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (optind >= argc || !rounds) {
+        usage();
+        return 1;
+    }
+    file = argv[optind];
+    if (!cache) {
+        if (!(cache_buf = malloc(strlen(file) + 7))) {
+            return 2;
+        }
+        sprintf(cache_buf, "%s.cache", file);
+        cache = cache_buf;
+    }
+
+    if (!(fp = fopen(file, "r"))) {
+        perror(file);
+        return 2;
+    }
+    for (conf_size = 0, conf = 0;;) {
+        char buf[65536];
+        n = fread(buf, 1, sizeof(buf), fp);
+        if (!n) {
+            break;
+        }
+        if (!(conf = realloc(conf, conf_size + n))) {
+            return 2;
+        }
+        memcpy(conf + conf_size, buf, n);
+        conf_size += n;
+    }
+    fclose(fp);
+    for (n = 0; n < conf_size; n++) {
+        if (conf[n] == '\n') {
+            conf_lines++;
+        }
+    }
+
+    /*
+     * Record all statements once for the syntax check benchmark
+     */
+    if (syntax_compile(syntax, &levels) != PARSECONF_OK) {
+        return 2;
+    }
+    memset(&record, 0, sizeof(record));
+    parser_init(&parser, 0, levels, error_callback);
+    parser.record = &record;
+    if (parse_buffer(&parser, conf, conf_size) != PARSECONF_OK) {
+        return 2;
+    }
+    statements = record.statements_size;
+    tokens     = record.tokens_size - statements;
+
+    printf("%s: %lu bytes, %lu lines, %lu statements, %lu tokens\n\n", file, conf_size, conf_lines, statements, tokens);
+
+    BENCH("parse_token", conf_size, conf_lines, tokens, bench_tokenize());
+    BENCH("parse_check", 0, 0, statements, {
+        const parseconf_syntax_t* s;
+        parseconf_error_t         e;
+        size_t                    t;
+        for (n = 0; n < statements; n++) {
+            parse_check(levels, &record.tokens[record.statements[n].tokens], record.statements[n].token, &s, &e, &t);
+        }
+    });
+    BENCH("syntax_compile", 0, 0, 1, {
+        syntax_level_t* l;
+        if (syntax_compile(syntax, &l) == PARSECONF_OK)
+            syntax_free(l);
+    });
+
+    BENCH("parseconf_file", conf_size, conf_lines, statements, parseconf_file(0, file, syntax, error_callback));
+    BENCH("parseconf_file stats", conf_size, conf_lines, statements, {
+        parseconf_stats_t   stats;
+        parseconf_options_t options = { &stats, 0, 0, 0, 0 };
+        memset(&stats, 0, sizeof(stats));
+        parseconf_file_options(0, file, syntax, error_callback, &options);
+        parseconf_stats_free(&stats);
+    });
+    BENCH("parseconf_file intern", conf_size, conf_lines, statements, {
+        parseconf_intern_t* intern;
+        if (parseconf_intern_new(&intern) == PARSECONF_OK) {
+            parseconf_options_t options = { 0, 0, intern, 0, 0 };
+            parseconf_file_options(0, file, syntax, error_callback, &options);
+            parseconf_intern_free(intern);
+        }
+    });
+    BENCH("parseconf_file limits", conf_size, conf_lines, statements, {
+        parseconf_limits_t  limits  = { 4096, 1024, (size_t)-1, (size_t)-1, (uint64_t)-1 / 2 };
+        parseconf_options_t options = { 0, 0, 0, &limits, 0 };
+        parseconf_file_options(0, file, syntax, error_callback, &options);
+    });
+    BENCH("parseconf_file_mmap", conf_size, conf_lines, statements, parseconf_file_mmap(0, file, syntax, error_callback));
+    BENCH("parseconf_file_parallel", conf_size, conf_lines, statements, parseconf_file_parallel(0, file, syntax, error_callback, threads));
+    BENCH("parseconf_file_parallel stats", conf_size, conf_lines, statements, {
+        parseconf_stats_t   stats;
+        parseconf_options_t options = { &stats, 0, 0, 0, threads ? threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN) };
+        memset(&stats, 0, sizeof(stats));
+        parseconf_file_options(0, file, syntax, error_callback, &options);
+        parseconf_stats_free(&stats);
+    });
+    unlink(cache);
+    parseconf_file_cached(0, file, cache, syntax, error_callback);
+    BENCH("parseconf_file_cached", conf_size, conf_lines, statements, parseconf_file_cached(0, file, cache, syntax, error_callback));
+    BENCH("parseconf_file_cached_stat", conf_size, conf_lines, statements, parseconf_file_cached_stat(0, file, cache, syntax, error_callback));
+    unlink(cache);
+    BENCH("parseconf_stream", conf_size, conf_lines, statements, {
+        parseconf_stream_t* stream;
+        if (parseconf_stream_new(&stream, 0, syntax, error_callback) == PARSECONF_OK) {
+            for (n = 0; n < conf_size; n += 4096) {
+                parseconf_stream_feed(stream, conf + n, conf_size - n < 4096 ? conf_size - n : 4096);
+            }
+            parseconf_stream_finish(stream);
+            parseconf_stream_free(stream);
+        }
+    });
+    BENCH("parseconf_text", conf_size, conf_lines, statements, {
+        const char *p = conf, *nl;
+        for (; (nl = memchr(p, '\n', conf_size - (p - conf))); p = nl + 1) {
+            parseconf_text(0, p, nl - p + 1, syntax, error_callback);
+        }
+    });
+    BENCH("parseconf_text whole", conf_size, conf_lines, statements, parseconf_text(0, conf, conf_size, syntax, error_callback));
+    if (parseconf_ctx_new(&ctx, syntax, error_callback) == PARSECONF_OK) {
+        BENCH("parseconf_ctx_file", conf_size, conf_lines, statements, parseconf_ctx_file(ctx, 0, file));
+        BENCH("parseconf_ctx_text", conf_size, conf_lines, statements, {
+            const char *p = conf, *nl;
+            for (; (nl = memchr(p, '\n', conf_size - (p - conf))); p = nl + 1) {
+                parseconf_ctx_text(ctx, 0, p, nl - p + 1);
+            }
+        });
+        BENCH("parseconf_ctx_text whole", conf_size, conf_lines, statements, parseconf_ctx_text(ctx, 0, conf, conf_size));
+        parseconf_ctx_free(ctx);
+    }
+    if (parseconf_ctx_new(&ctx, parsebench_syntax, error_callback) == PARSECONF_OK) {
+        parseconf_ctx_check(ctx, parsebench_check);
+        BENCH("parseconf_ctx_file generated", conf_size, conf_lines, statements, parseconf_ctx_file(ctx, 0, file));
+        parseconf_ctx_free(ctx);
+    }
+
+    bench_values();
+    bench_addresses();
+    bench_units();
+
+    parser_free(&parser);
+    record_free(&record);
+    syntax_free(levels);
+    free(conf);
+    free(cache_buf);
+
+    return checksum ? 0 : 1;
+}
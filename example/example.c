@@ -21,20 +21,50 @@
 
 #include "config.h"
 #include "parseconf.h"
+#include "example-syntax.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
 
 void usage(void)
 {
     printf(
         "usage: example [options] <config...>\n"
         " -f                 the config is a file (default)\n"
+        " -m                 the config is a file, map it into memory\n"
+        " -s                 the config is a file, stream it in small chunks\n"
+        " -p <threads>       the config is a file, parse it using threads, also\n"
+        "                    with -a, -i, -l and -t if given after this\n"
+        " -c <cache>         the config is a file, use a cache of the parsed file\n"
+        " -C <cache>         like -c but trust the modification time and inode\n"
+        "                    of the file instead of hashing it\n"
+        " -a                 the config is a file, keep the last token of each\n"
+        "                    statement in an arena and display them at the end\n"
+        " -i                 the config is a file, intern strings and display\n"
+        "                    their ids\n"
+        " -r                 the config is a file, reload it for each argument\n"
+        "                    and display what was removed and added\n"
+        " -d <threads>       the config is a directory, parse all files in it\n"
+        "                    using threads\n"
+        " -w <reloads>       the config is a file, watch it for changes and\n"
+        "                    display each snapshot until reloaded this many times\n"
+        " -l <limits>        the config is a file, parse it with the limits given\n"
+        "                    as line,token,bytes,statements,nanoseconds\n"
         " -t                 the config is text\n"
+        " -x                 use one context for all arguments, for -f and -t\n"
+        " -g                 use the syntax and check generated by parsegen from\n"
+        "                    example.syntax, for -x\n"
+        " -e                 display the tokens given with an error\n"
+        " -S                 display parse statistics, for -f, -s, -p, -d and -t\n"
         "                    multiple config options can be given but each command\n"
         "                    line argument is parse separate\n"
+        " -y                 compile syntax that is not valid and display the errors\n"
         " -V                 display version and exit\n"
         " -h                 this\n");
 }
@@ -43,10 +73,22 @@ static parseconf_token_type_t example_tokens[] = {
     PARSECONF_TOKEN_ANY, PARSECONF_TOKEN_END
 };
 
-static int parse_example(void* user, const parseconf_token_t* tokens, const char** errstr)
+static parseconf_arena_t* arena = 0;
+static const char*        retained[64];
+static size_t             retained_size = 0;
+
+typedef struct example_snapshot example_snapshot_t;
+struct example_snapshot {
+    size_t generation, statements;
+};
+
+static size_t generation = 0;
+
+int parse_example(void* user, const parseconf_token_t* tokens, const char** errstr)
 {
     unsigned long long int num = 0;
     long double            dbl = 0.;
+    char                   address[INET6_ADDRSTRLEN];
     int                    i;
 
     if (!tokens) {
@@ -55,6 +97,9 @@ static int parse_example(void* user, const parseconf_token_t* tokens, const char
     if (!errstr) {
         return 1;
     }
+    if (user) {
+        ((example_snapshot_t*)user)->statements++;
+    }
 
     for (i = 0; tokens[i].type != PARSECONF_TOKEN_END; i++) {
         switch (tokens[i].type) {
@@ -66,10 +111,14 @@ static int parse_example(void* user, const parseconf_token_t* tokens, const char
 
         case PARSECONF_TOKEN_STRING:
             printf("%d string: %.*s\n", i, (int)tokens[i].length, tokens[i].token);
+            if (tokens[i].id)
+                printf("%d id: %u\n", i, tokens[i].id);
             break;
 
         case PARSECONF_TOKEN_QSTRING:
             printf("%d quoted string: %.*s\n", i, (int)tokens[i].length, tokens[i].token);
+            if (tokens[i].id)
+                printf("%d id: %u\n", i, tokens[i].id);
             break;
 
         case PARSECONF_TOKEN_FLOAT:
@@ -78,22 +127,222 @@ static int parse_example(void* user, const parseconf_token_t* tokens, const char
             printf("%d number: %Le\n", i, dbl);
             break;
 
+        case PARSECONF_TOKEN_IPADDR:
+            if (!inet_ntop(tokens[i].family, tokens[i].data.address, address, sizeof(address)))
+                return 1;
+            printf("%d address: %s\n", i, address);
+            break;
+
+        case PARSECONF_TOKEN_PREFIX:
+            if (!inet_ntop(tokens[i].family, tokens[i].data.address, address, sizeof(address)))
+                return 1;
+            printf("%d prefix: %s/%u\n", i, address, tokens[i].prefix);
+            break;
+
+        case PARSECONF_TOKEN_DURATION:
+            printf("%d duration: %" PRIu64 " ns\n", i, tokens[i].data.value);
+            break;
+
+        case PARSECONF_TOKEN_SIZE:
+            printf("%d size: %" PRIu64 " bytes\n", i, tokens[i].data.value);
+            break;
+
         default:
             *errstr = "Unknown token type";
             return 1;
         }
     }
+    if (arena && i && retained_size < sizeof(retained) / sizeof(*retained)) {
+        retained[retained_size++] = tokens[i - 1].token;
+    }
+
+    return 0;
+}
+
+int parse_remove(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    /*
+     * A statement that can not be removed, to show a failed remove
+     */
+    if (tokens[1].type == PARSECONF_TOKEN_STRING && tokens[1].length == 6 && !memcmp(tokens[1].token, "sticky", 6)) {
+        *errstr = "Can not be removed";
+        return 1;
+    }
+
+    printf("removed:");
+    for (; tokens->type != PARSECONF_TOKEN_END; tokens++) {
+        printf(" %s", tokens->token);
+    }
+    printf("\n");
+
+    return 0;
+}
+
+int parse_batch(void* user, const parseconf_statement_t* statements, size_t size, size_t* failed, const char** errstr)
+{
+    size_t i;
+
+    printf("batch of %lu\n", size);
+    for (i = 0; i < size; i++) {
+        if (parse_example(user, statements[i].tokens, errstr)) {
+            *failed = i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Convert all arguments with one call
+ */
+int parse_numbers(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    uint64_t values[64];
+    size_t   n, failed = 0;
+
+    for (n = 0; tokens[n + 1].type != PARSECONF_TOKEN_END; n++)
+        ;
+    if (n > sizeof(values) / sizeof(*values)) {
+        *errstr = "Too many numbers";
+        return 1;
+    }
+    if (parseconf_numbers_u64(tokens, 1, values, n, &failed, errstr)) {
+        printf("numbers: argument %lu failed\n", failed);
+        return 1;
+    }
+    for (failed = 0; failed < n; failed++) {
+        printf("%lu number: %" PRIu64 "\n", failed + 1, values[failed]);
+    }
+
+    return 0;
+}
+
+int parse_floats(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    double values[64];
+    size_t n, failed = 0;
+
+    for (n = 0; tokens[n + 1].type != PARSECONF_TOKEN_END; n++)
+        ;
+    if (n > sizeof(values) / sizeof(*values)) {
+        *errstr = "Too many floats";
+        return 1;
+    }
+    if (parseconf_numbers_double(tokens, 1, values, n, &failed, errstr)) {
+        printf("floats: argument %lu failed\n", failed);
+        return 1;
+    }
+    for (failed = 0; failed < n; failed++) {
+        printf("%lu float: %.17g\n", failed + 1, values[failed]);
+    }
 
     return 0;
 }
 
+static parseconf_token_type_t numbers_tokens[] = {
+    PARSECONF_TOKEN_NUMBERS, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t floats_tokens[] = {
+    PARSECONF_TOKEN_FLOATS, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t listen_tokens[] = {
+    PARSECONF_TOKEN_IPADDR, PARSECONF_TOKEN_NUMBER, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t allow_tokens[] = {
+    PARSECONF_TOKEN_PREFIXES, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t timeout_tokens[] = {
+    PARSECONF_TOKEN_DURATION, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t buffer_tokens[] = {
+    PARSECONF_TOKEN_SIZE, PARSECONF_TOKEN_END
+};
+
+static parseconf_token_type_t nested_tokens[] = {
+    PARSECONF_TOKEN_NESTED, PARSECONF_TOKEN_END
+};
+
+static parseconf_syntax_t nested_syntax[] = {
+    { "example", parse_example, example_tokens, 0, 0, 0, parse_remove },
+    { "nested", 0, nested_tokens, nested_syntax, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
 static parseconf_syntax_t syntax[] = {
-    { "example", parse_example, example_tokens, 0 },
+    { "example", parse_example, example_tokens, 0, 0, 0, parse_remove },
+    { "nested", 0, nested_tokens, nested_syntax, 0, 0, 0 },
+    { "batch", 0, example_tokens, 0, parse_batch, 2, parse_remove },
+    { "numbers", parse_numbers, numbers_tokens, 0, 0, 0, 0 },
+    { "floats", parse_floats, floats_tokens, 0, 0, 0, 0 },
+    { "listen", parse_example, listen_tokens, 0, 0, 0, 0 },
+    { "allow", parse_example, allow_tokens, 0, 0, 0, 0 },
+    { "timeout", parse_example, timeout_tokens, 0, 0, 0, 0 },
+    { "buffer", parse_example, buffer_tokens, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+/*
+ * Syntax that fails to compile, for -y
+ */
+static parseconf_token_type_t unknown_tokens[] = {
+    PARSECONF_TOKEN_STRING, (parseconf_token_type_t)PARSECONF_TOKEN_TYPES, PARSECONF_TOKEN_END
+};
+
+static parseconf_syntax_t unknown_syntax[] = {
+    { "example", parse_example, unknown_tokens, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static parseconf_syntax_t no_nested_syntax[] = {
+    { "nested", 0, nested_tokens, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static parseconf_syntax_t no_callback_syntax[] = {
+    { "example", 0, example_tokens, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static parseconf_syntax_t no_tokens_syntax[] = {
+    { "example", parse_example, 0, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static parseconf_syntax_t invalid_nested_syntax[] = {
+    { "example", parse_example, example_tokens, 0, 0, 0, 0 },
+    { "nested", 0, nested_tokens, no_callback_syntax, 0, 0, 0 },
     PARSECONF_SYNTAX_END
 };
 
+static const struct {
+    const char*               name;
+    const parseconf_syntax_t* syntax;
+} invalid_syntax[] = {
+    { "valid", syntax },
+    { "unknown token type", unknown_syntax },
+    { "nested without nested syntax", no_nested_syntax },
+    { "no callback", no_callback_syntax },
+    { "no token types", no_tokens_syntax },
+    { "invalid nested syntax", invalid_nested_syntax }
+};
+
+static int error_tokens = 0;
+
 static void error_callback(void* user, parseconf_error_t error, size_t line, size_t token, const parseconf_token_t* tokens, const char* errstr)
 {
+    if (errstr && error != PARSECONF_ERROR_CALLBACK) {
+        /*
+         * Error in an included file
+         */
+        fprintf(stderr, "In %s: ", errstr);
+    }
+
     switch (error) {
     case PARSECONF_ERROR_INTERNAL:
         fprintf(stderr, "Internal conf error at line %lu\n", line);
@@ -147,24 +396,265 @@ static void error_callback(void* user, parseconf_error_t error, size_t line, siz
         fprintf(stderr, "Conf error at line %lu, invalid syntax\n", line);
         break;
 
+    case PARSECONF_ERROR_INCLUDE_CYCLE:
+        fprintf(stderr, "Conf error at line %lu, include cycle\n", line);
+        break;
+
+    case PARSECONF_ERROR_LINE_TOO_LONG:
+        fprintf(stderr, "Conf error at line %lu, line too long\n", line);
+        break;
+
+    case PARSECONF_ERROR_TOKEN_TOO_LONG:
+        fprintf(stderr, "Conf error at line %lu, token too long\n", line);
+        break;
+
+    case PARSECONF_ERROR_TOO_MANY_BYTES:
+        fprintf(stderr, "Conf error at line %lu, too many bytes\n", line);
+        break;
+
+    case PARSECONF_ERROR_TOO_MANY_STATEMENTS:
+        fprintf(stderr, "Conf error at line %lu, too many statements\n", line);
+        break;
+
+    case PARSECONF_ERROR_TIMEOUT:
+        fprintf(stderr, "Conf error at line %lu, time limit exceeded\n", line);
+        break;
+
+    case PARSECONF_ERROR_EXPECT_IPADDR:
+        fprintf(stderr, "Conf error at line %lu for argument %lu, expected an IP address\n", line, token);
+        break;
+
+    case PARSECONF_ERROR_EXPECT_PREFIX:
+        fprintf(stderr, "Conf error at line %lu for argument %lu, expected an IP prefix\n", line, token);
+        break;
+
+    case PARSECONF_ERROR_EXPECT_DURATION:
+        fprintf(stderr, "Conf error at line %lu for argument %lu, expected a duration\n", line, token);
+        break;
+
+    case PARSECONF_ERROR_EXPECT_SIZE:
+        fprintf(stderr, "Conf error at line %lu for argument %lu, expected a size\n", line, token);
+        break;
+
     default:
         fprintf(stderr, "Unknown conf error %d at %lu\n", error, line);
         break;
     }
+
+    if (error_tokens && tokens) {
+        size_t n;
+
+        for (n = 0; tokens[n].type != PARSECONF_TOKEN_END; n++) {
+            fprintf(stderr, "error token %lu: %.*s\n", n, (int)tokens[n].length, tokens[n].token);
+        }
+    }
 }
 
-int main(int argc, char** argv)
+static parseconf_stats_t* stats = 0;
+
+static void print_stats(void)
+{
+    size_t n;
+
+    printf("stats: bytes %lu lines %lu statements %lu\n", stats->bytes, stats->lines, stats->statements);
+    printf("stats: tokens string %lu qstring %lu number %lu float %lu ipaddr %lu prefix %lu duration %lu size %lu\n", stats->tokens[PARSECONF_TOKEN_STRING], stats->tokens[PARSECONF_TOKEN_QSTRING], stats->tokens[PARSECONF_TOKEN_NUMBER], stats->tokens[PARSECONF_TOKEN_FLOAT], stats->tokens[PARSECONF_TOKEN_IPADDR], stats->tokens[PARSECONF_TOKEN_PREFIX], stats->tokens[PARSECONF_TOKEN_DURATION], stats->tokens[PARSECONF_TOKEN_SIZE]);
+    printf("stats: line peak %lu\n", stats->line_peak);
+    for (n = 0; n < stats->keywords_size; n++) {
+        printf("stats: keyword %s calls %lu\n", stats->keywords[n].syntax->token, stats->keywords[n].calls);
+    }
+}
+
+static int stream_file(const char* file)
+{
+    parseconf_stream_t* stream;
+    FILE*               fp;
+    char                buf[16];
+    parseconf_options_t options = { stats, 0, 0, 0, 0 };
+    size_t              n;
+    int                 err;
+
+    if (!(fp = fopen(file, "r"))) {
+        return PARSECONF_ERROR;
+    }
+    if ((err = parseconf_stream_new(&stream, 0, syntax, error_callback)) != PARSECONF_OK) {
+        fclose(fp);
+        return err;
+    }
+    if ((err = parseconf_stream_options(stream, &options)) != PARSECONF_OK) {
+        parseconf_stream_free(stream);
+        fclose(fp);
+        return err;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if ((err = parseconf_stream_feed(stream, buf, n)) != PARSECONF_OK) {
+            break;
+        }
+    }
+    if (err == PARSECONF_OK) {
+        err = parseconf_stream_finish(stream);
+    }
+    parseconf_stream_free(stream);
+    fclose(fp);
+
+    return err;
+}
+
+static void* snapshot_new(void* arg)
 {
-    int opt, file = 1, err;
+    example_snapshot_t* snapshot;
 
-    while ((opt = getopt(argc, argv, "fthV")) != -1) {
+    if ((snapshot = calloc(1, sizeof(example_snapshot_t)))) {
+        snapshot->generation = ++generation;
+    }
+
+    return snapshot;
+}
+
+static void snapshot_free(void* arg, void* snapshot)
+{
+    free(snapshot);
+}
+
+/*
+ * Watch the file and display each new snapshot until `reloads` have been
+ * published
+ */
+static int watch_file(const char* file, size_t reloads)
+{
+    parseconf_watch_t*        watch;
+    parseconf_watch_reader_t* reader;
+    example_snapshot_t*       snapshot;
+    size_t                    current = 0, n = 0;
+    int                       err;
+
+    if ((err = parseconf_watch_new(&watch, file, syntax, error_callback, snapshot_new, snapshot_free, 0)) != PARSECONF_OK) {
+        return err;
+    }
+    if ((err = parseconf_watch_reader_new(watch, &reader)) != PARSECONF_OK) {
+        parseconf_watch_free(watch);
+        return err;
+    }
+    while (1) {
+        snapshot = parseconf_watch_enter(reader);
+        if (snapshot->generation != current) {
+            if (current)
+                printf("snapshot %lu: %lu statements\n", ++n, snapshot->statements);
+            else
+                printf("watching: %lu statements\n", snapshot->statements);
+            fflush(stdout);
+            current = snapshot->generation;
+        }
+        parseconf_watch_leave(reader);
+        if (n >= reloads) {
+            break;
+        }
+        usleep(10000);
+    }
+    parseconf_watch_reader_free(reader);
+    parseconf_watch_free(watch);
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Compile each syntax in `invalid_syntax` and display the error
+ */
+static int check_invalid_syntax(void)
+{
+    parseconf_ctx_t* ctx;
+    size_t           n;
+    int              err;
+
+    for (n = 0; n < sizeof(invalid_syntax) / sizeof(invalid_syntax[0]); n++) {
+        err = parseconf_text(0, "", 0, invalid_syntax[n].syntax, error_callback);
+        printf("%s: text %s", invalid_syntax[n].name, err == PARSECONF_OK ? "ok" : parseconf_strerror(err));
+        if ((err = parseconf_ctx_new(&ctx, invalid_syntax[n].syntax, error_callback)) == PARSECONF_OK) {
+            parseconf_ctx_free(ctx);
+        }
+        printf(", ctx %s\n", err == PARSECONF_OK ? "ok" : parseconf_strerror(err));
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int                 opt, file = 1, err;
+    size_t              threads = 0, reloads = 0;
+    const char*         cache   = 0;
+    parseconf_stats_t   stats_buf;
+    parseconf_limits_t  limits;
+    parseconf_reload_t* reload  = 0;
+    parseconf_ctx_t*    ctx     = 0;
+    int                 use_ctx = 0, generated = 0;
+
+    while ((opt = getopt(argc, argv, "fmsp:c:C:aird:w:l:txgeSyhV")) != -1) {
         switch (opt) {
         case 'f':
             file = 1;
             break;
+        case 'm':
+            file = 2;
+            break;
+        case 's':
+            file = 3;
+            break;
+        case 'p':
+            file    = 4;
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 'c':
+            file  = 5;
+            cache = optarg;
+            break;
+        case 'C':
+            file  = 12;
+            cache = optarg;
+            break;
+        case 'a':
+            file = 6;
+            break;
+        case 'i':
+            file = 7;
+            break;
+        case 'r':
+            file = 8;
+            break;
+        case 'd':
+            file    = 9;
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 'w':
+#if !PARSECONF_ENABLE_WATCH
+            fprintf(stderr, "watching is not supported\n");
+            return 77;
+#endif
+            file    = 10;
+            reloads = strtoul(optarg, 0, 10);
+            break;
+        case 'l':
+            file = 11;
+            memset(&limits, 0, sizeof(limits));
+            sscanf(optarg, "%lu,%lu,%lu,%lu,%" SCNu64, &limits.line_length, &limits.token_length, &limits.bytes, &limits.statements, &limits.time);
+            break;
         case 't':
             file = 0;
             break;
+        case 'x':
+            use_ctx = 1;
+            break;
+        case 'g':
+            generated = 1;
+            break;
+        case 'e':
+            error_tokens = 1;
+            break;
+        case 'S':
+            memset(&stats_buf, 0, sizeof(stats_buf));
+            stats = &stats_buf;
+            break;
+        case 'y':
+            return check_invalid_syntax();
         case 'h':
             usage();
             return 0;
@@ -177,19 +667,102 @@ int main(int argc, char** argv)
         }
     }
 
+    if (use_ctx && (err = parseconf_ctx_new(&ctx, generated ? example_syntax : syntax, error_callback)) != PARSECONF_OK) {
+        fprintf(stderr, "parseconf_ctx_new(): %s\n", parseconf_strerror(err));
+        return 2;
+    }
+    if (ctx && generated && (err = parseconf_ctx_check(ctx, example_check)) != PARSECONF_OK) {
+        fprintf(stderr, "parseconf_ctx_check(): %s\n", parseconf_strerror(err));
+        parseconf_ctx_free(ctx);
+        return 2;
+    }
+
     while (optind < argc) {
-        if (file)
+        parseconf_options_t options = { stats, 0, 0, 0, threads };
+
+        if (file == 11) {
+            options.limits = &limits;
+            err            = parseconf_file_options(0, argv[optind], syntax, error_callback, &options);
+        } else if (file == 10)
+            err = watch_file(argv[optind], reloads);
+        else if (ctx && file == 1)
+            err = parseconf_ctx_file(ctx, 0, argv[optind]);
+        else if (ctx && !file)
+            err = parseconf_ctx_text(ctx, 0, argv[optind], strlen(argv[optind]));
+        else if (file == 9 && stats)
+            err = parseconf_dir_options(0, argv[optind], syntax, error_callback, &options);
+        else if (file == 9)
+            err = parseconf_dir(0, argv[optind], syntax, error_callback, threads);
+        else if (file == 8) {
+            if (reload || (err = parseconf_reload_new(&reload)) == PARSECONF_OK) {
+                printf("reload: %s\n", strrchr(argv[optind], '/') ? strrchr(argv[optind], '/') + 1 : argv[optind]);
+                if ((err = parseconf_file_reload(0, argv[optind], syntax, error_callback, reload)) == PARSECONF_ERROR) {
+                    /*
+                     * Keep running with the previous config
+                     */
+                    printf("reload failed\n");
+                    err = PARSECONF_OK;
+                }
+            }
+        } else if (file == 7) {
+            parseconf_intern_t* intern;
+
+            if ((err = parseconf_intern_new(&intern)) == PARSECONF_OK) {
+                options.intern = intern;
+                err            = parseconf_file_options(0, argv[optind], syntax, error_callback, &options);
+                printf("interned: %lu strings\n", parseconf_intern_size(intern));
+                parseconf_intern_free(intern);
+            }
+        } else if (file == 6) {
+            size_t n;
+
+            if ((err = parseconf_arena_new(&arena)) == PARSECONF_OK) {
+                options.arena = arena;
+                err           = parseconf_file_options(0, argv[optind], syntax, error_callback, &options);
+            }
+            for (n = 0; n < retained_size; n++) {
+                printf("retained: %s\n", retained[n]);
+            }
+            retained_size = 0;
+            parseconf_arena_free(arena);
+            arena = 0;
+        } else if (file == 12)
+            err = parseconf_file_cached_stat(0, argv[optind], cache, syntax, error_callback);
+        else if (file == 5)
+            err = parseconf_file_cached(0, argv[optind], cache, syntax, error_callback);
+        else if (file == 4 && stats)
+            err = parseconf_file_options(0, argv[optind], syntax, error_callback, &options);
+        else if (file == 4)
+            err = parseconf_file_parallel(0, argv[optind], syntax, error_callback, threads);
+        else if (file == 3)
+            err = stream_file(argv[optind]);
+        else if (file == 2)
+            err = parseconf_file_mmap(0, argv[optind], syntax, error_callback);
+        else if (file && stats)
+            err = parseconf_file_options(0, argv[optind], syntax, error_callback, &options);
+        else if (file)
             err = parseconf_file(0, argv[optind], syntax, error_callback);
+        else if (stats || threads)
+            err = parseconf_text_options(0, argv[optind], strlen(argv[optind]), syntax, error_callback, &options);
         else
             err = parseconf_text(0, argv[optind], strlen(argv[optind]), syntax, error_callback);
 
+        if (stats) {
+            print_stats();
+            parseconf_stats_free(stats);
+        }
+
         if (err != PARSECONF_OK) {
-            fprintf(stderr, file ? "parseconf_file(%s): %s" : "parseconf_text(%s): %s\n", argv[optind], parseconf_strerror(err));
+            fprintf(stderr, file ? "parseconf_file(%s): %s\n" : "parseconf_text(%s): %s\n", argv[optind], parseconf_strerror(err));
+            parseconf_reload_free(reload);
+            parseconf_ctx_free(ctx);
             return 2;
         }
 
         optind++;
     }
+    parseconf_reload_free(reload);
+    parseconf_ctx_free(ctx);
 
     return 0;
 }
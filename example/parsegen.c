@@ -0,0 +1,797 @@
+/*
+ * Author Jerry Lundström <jerry@dns-oarc.net>
+ * Copyright (c) 2017, OARC, Inc.
+ * All rights reserved.
+ *
+ * This file is part of parseconf.
+ *
+ * parseconf is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * parseconf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "parseconf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+/*
+ * Generate the syntax tables and a check function for a syntax description
+ * so the syntax does not need to be compiled and interpreted at runtime.
+ *
+ * The description is itself parsed with parseconf:
+ *
+ *   syntax <name>;                 name of the syntax, the generated code is
+ *                                  <name>_syntax and <name>_check
+ *   level <name>;                  start a level, the first is the top level
+ *   keyword <token> <types...>;    add a keyword to the level, types are
+ *                                  string, qstring, number, float, strings,
+ *                                  qstrings, numbers, floats, any, ipaddr,
+ *                                  prefix, ipaddrs, prefixes, duration, size
+ *                                  and nested <level>
+ *   callback <function>;           callback of the last keyword
+ *   batch <function> <size>;       batch callback of the last keyword
+ *   remove <function>;             remove callback of the last keyword
+ *
+ * The check function does a switch on the length of the keyword followed
+ * by a compare with the keywords of that length, then checks the arguments
+ * with the type checks unrolled and returns the syntax entry. It is used
+ * with parseconf_ctx_check() on a context created with <name>_syntax.
+ */
+
+static void usage(void)
+{
+    printf(
+        "usage: parsegen [options] <description>\n"
+        " -o <file>          write the source to file (default stdout)\n"
+        " -H <file>          also write a header to file\n"
+        " -h                 this\n");
+}
+
+typedef struct gen_keyword gen_keyword_t;
+struct gen_keyword {
+    char*                   token;
+    parseconf_token_type_t* types;
+    size_t                  types_size;
+    char *                  nested, *callback, *batch, *remove;
+    unsigned long           batch_size;
+};
+
+typedef struct gen_level gen_level_t;
+struct gen_level {
+    char*          name;
+    gen_keyword_t* keywords;
+    size_t         keywords_size;
+};
+
+typedef struct gen gen_t;
+struct gen {
+    char*        name;
+    gen_level_t* levels;
+    size_t       levels_size;
+};
+
+static const struct {
+    const char*            name;
+    parseconf_token_type_t type;
+    const char*            define;
+    const char*            check;
+    const char*            error;
+} gen_types[] = {
+    { "string", PARSECONF_TOKEN_STRING, "PARSECONF_TOKEN_STRING", "tokens[i].type != PARSECONF_TOKEN_STRING && tokens[i].type != PARSECONF_TOKEN_IPADDR && tokens[i].type != PARSECONF_TOKEN_PREFIX && tokens[i].type != PARSECONF_TOKEN_DURATION && tokens[i].type != PARSECONF_TOKEN_SIZE", "PARSECONF_ERROR_EXPECT_STRING" },
+    { "qstring", PARSECONF_TOKEN_QSTRING, "PARSECONF_TOKEN_QSTRING", "tokens[i].type != PARSECONF_TOKEN_QSTRING", "PARSECONF_ERROR_EXPECT_QSTRING" },
+    { "number", PARSECONF_TOKEN_NUMBER, "PARSECONF_TOKEN_NUMBER", "tokens[i].type != PARSECONF_TOKEN_NUMBER", "PARSECONF_ERROR_EXPECT_NUMBER" },
+    { "float", PARSECONF_TOKEN_FLOAT, "PARSECONF_TOKEN_FLOAT", "tokens[i].type != PARSECONF_TOKEN_FLOAT", "PARSECONF_ERROR_EXPECT_FLOAT" },
+    { "strings", PARSECONF_TOKEN_STRINGS, "PARSECONF_TOKEN_STRINGS", "tokens[i].type != PARSECONF_TOKEN_STRING && tokens[i].type != PARSECONF_TOKEN_IPADDR && tokens[i].type != PARSECONF_TOKEN_PREFIX && tokens[i].type != PARSECONF_TOKEN_DURATION && tokens[i].type != PARSECONF_TOKEN_SIZE", "PARSECONF_ERROR_EXPECT_STRING" },
+    { "qstrings", PARSECONF_TOKEN_QSTRINGS, "PARSECONF_TOKEN_QSTRINGS", "tokens[i].type != PARSECONF_TOKEN_QSTRING", "PARSECONF_ERROR_EXPECT_QSTRING" },
+    { "numbers", PARSECONF_TOKEN_NUMBERS, "PARSECONF_TOKEN_NUMBERS", "tokens[i].type != PARSECONF_TOKEN_NUMBER", "PARSECONF_ERROR_EXPECT_NUMBER" },
+    { "floats", PARSECONF_TOKEN_FLOATS, "PARSECONF_TOKEN_FLOATS", "tokens[i].type != PARSECONF_TOKEN_FLOAT", "PARSECONF_ERROR_EXPECT_FLOAT" },
+    { "any", PARSECONF_TOKEN_ANY, "PARSECONF_TOKEN_ANY", "tokens[i].type != PARSECONF_TOKEN_STRING && tokens[i].type != PARSECONF_TOKEN_NUMBER && tokens[i].type != PARSECONF_TOKEN_QSTRING && tokens[i].type != PARSECONF_TOKEN_FLOAT && tokens[i].type != PARSECONF_TOKEN_IPADDR && tokens[i].type != PARSECONF_TOKEN_PREFIX && tokens[i].type != PARSECONF_TOKEN_DURATION && tokens[i].type != PARSECONF_TOKEN_SIZE", "PARSECONF_ERROR_EXPECT_ANY" },
+    { "ipaddr", PARSECONF_TOKEN_IPADDR, "PARSECONF_TOKEN_IPADDR", "tokens[i].type != PARSECONF_TOKEN_IPADDR", "PARSECONF_ERROR_EXPECT_IPADDR" },
+    { "prefix", PARSECONF_TOKEN_PREFIX, "PARSECONF_TOKEN_PREFIX", "tokens[i].type != PARSECONF_TOKEN_PREFIX && tokens[i].type != PARSECONF_TOKEN_IPADDR", "PARSECONF_ERROR_EXPECT_PREFIX" },
+    { "ipaddrs", PARSECONF_TOKEN_IPADDRS, "PARSECONF_TOKEN_IPADDRS", "tokens[i].type != PARSECONF_TOKEN_IPADDR", "PARSECONF_ERROR_EXPECT_IPADDR" },
+    { "prefixes", PARSECONF_TOKEN_PREFIXES, "PARSECONF_TOKEN_PREFIXES", "tokens[i].type != PARSECONF_TOKEN_PREFIX && tokens[i].type != PARSECONF_TOKEN_IPADDR", "PARSECONF_ERROR_EXPECT_PREFIX" },
+    { "duration", PARSECONF_TOKEN_DURATION, "PARSECONF_TOKEN_DURATION", "tokens[i].type != PARSECONF_TOKEN_DURATION", "PARSECONF_ERROR_EXPECT_DURATION" },
+    { "size", PARSECONF_TOKEN_SIZE, "PARSECONF_TOKEN_SIZE", "tokens[i].type != PARSECONF_TOKEN_SIZE", "PARSECONF_ERROR_EXPECT_SIZE" },
+    { "nested", PARSECONF_TOKEN_NESTED, "PARSECONF_TOKEN_NESTED", 0, 0 },
+    { 0, PARSECONF_TOKEN_END, 0, 0, 0 }
+};
+
+static size_t gen_type(parseconf_token_type_t type)
+{
+    size_t n;
+
+    for (n = 0; gen_types[n].name && gen_types[n].type != type; n++)
+        ;
+
+    return n;
+}
+
+static int gen_repeat(parseconf_token_type_t type)
+{
+    return type == PARSECONF_TOKEN_STRINGS || type == PARSECONF_TOKEN_QSTRINGS || type == PARSECONF_TOKEN_NUMBERS || type == PARSECONF_TOKEN_FLOATS || type == PARSECONF_TOKEN_ANY || type == PARSECONF_TOKEN_IPADDRS || type == PARSECONF_TOKEN_PREFIXES;
+}
+
+static int gen_identifier(const parseconf_token_t* token)
+{
+    size_t n;
+
+    for (n = 0; n < token->length; n++) {
+        char c = token->token[n];
+
+        if (!(c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (n && c >= '0' && c <= '9'))) {
+            return 0;
+        }
+    }
+
+    return n > 0;
+}
+
+static char* gen_strdup(const parseconf_token_t* token)
+{
+    char* s;
+
+    if ((s = malloc(token->length + 1))) {
+        memcpy(s, token->token, token->length);
+        s[token->length] = 0;
+    }
+
+    return s;
+}
+
+static void gen_free(gen_t* gen)
+{
+    size_t l, k;
+
+    for (l = 0; l < gen->levels_size; l++) {
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            gen_keyword_t* keyword = &gen->levels[l].keywords[k];
+
+            free(keyword->token);
+            free(keyword->types);
+            free(keyword->nested);
+            free(keyword->callback);
+            free(keyword->batch);
+            free(keyword->remove);
+        }
+        free(gen->levels[l].keywords);
+        free(gen->levels[l].name);
+    }
+    free(gen->levels);
+    free(gen->name);
+}
+
+static gen_level_t* gen_find(gen_t* gen, const char* name)
+{
+    size_t l;
+
+    for (l = 0; l < gen->levels_size; l++) {
+        if (!strcmp(gen->levels[l].name, name)) {
+            return &gen->levels[l];
+        }
+    }
+
+    return 0;
+}
+
+static gen_keyword_t* gen_last(gen_t* gen, const char** errstr)
+{
+    gen_level_t* level;
+
+    if (!gen->levels_size || !(level = &gen->levels[gen->levels_size - 1])->keywords_size) {
+        *errstr = "No keyword to set the callback for";
+        return 0;
+    }
+
+    return &level->keywords[level->keywords_size - 1];
+}
+
+/*
+ * Description callbacks
+ */
+
+static int parse_syntax(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    gen_t* gen = user;
+
+    if (gen->name) {
+        *errstr = "Syntax name already given";
+        return 1;
+    }
+    if (!gen_identifier(&tokens[1])) {
+        *errstr = "Syntax name is not a valid identifier";
+        return 1;
+    }
+    if (!(gen->name = gen_strdup(&tokens[1]))) {
+        *errstr = "Out of memory";
+        return 1;
+    }
+
+    return 0;
+}
+
+static int parse_level(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    gen_t*       gen = user;
+    gen_level_t* levels;
+    char*        name;
+
+    if (!gen_identifier(&tokens[1])) {
+        *errstr = "Level name is not a valid identifier";
+        return 1;
+    }
+    if (!(name = gen_strdup(&tokens[1]))) {
+        *errstr = "Out of memory";
+        return 1;
+    }
+    if (gen_find(gen, name)) {
+        *errstr = "Level already defined";
+        free(name);
+        return 1;
+    }
+    if (!(levels = realloc(gen->levels, (gen->levels_size + 1) * sizeof(gen_level_t)))) {
+        *errstr = "Out of memory";
+        free(name);
+        return 1;
+    }
+    gen->levels = levels;
+    memset(&levels[gen->levels_size], 0, sizeof(gen_level_t));
+    levels[gen->levels_size++].name = name;
+
+    return 0;
+}
+
+static int parse_keyword(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    gen_t*         gen = user;
+    gen_level_t*   level;
+    gen_keyword_t *keywords, *keyword;
+    size_t         n, t;
+
+    if (!gen->levels_size) {
+        *errstr = "Keyword outside of a level";
+        return 1;
+    }
+    level = &gen->levels[gen->levels_size - 1];
+    for (n = 0; n < level->keywords_size; n++) {
+        if (strlen(level->keywords[n].token) == tokens[1].length && !memcmp(level->keywords[n].token, tokens[1].token, tokens[1].length)) {
+            *errstr = "Keyword already defined in this level";
+            return 1;
+        }
+    }
+    if (!(keywords = realloc(level->keywords, (level->keywords_size + 1) * sizeof(gen_keyword_t)))) {
+        *errstr = "Out of memory";
+        return 1;
+    }
+    level->keywords = keywords;
+    keyword         = &keywords[level->keywords_size++];
+    memset(keyword, 0, sizeof(gen_keyword_t));
+
+    for (n = 0; tokens[n].type != PARSECONF_TOKEN_END; n++)
+        ;
+    if (!(keyword->token = gen_strdup(&tokens[1])) || !(keyword->types = calloc(n, sizeof(parseconf_token_type_t)))) {
+        *errstr = "Out of memory";
+        return 1;
+    }
+
+    /*
+     * Repeating types and nested take all remaining arguments so they have
+     * to be last
+     */
+    for (n = 2; tokens[n].type != PARSECONF_TOKEN_END; n++) {
+        for (t = 0; gen_types[t].name && (strlen(gen_types[t].name) != tokens[n].length || memcmp(gen_types[t].name, tokens[n].token, tokens[n].length)); t++)
+            ;
+        if (!gen_types[t].name) {
+            *errstr = "Unknown type";
+            return 1;
+        }
+        if (keyword->types_size && (gen_repeat(keyword->types[keyword->types_size - 1]) || keyword->types[keyword->types_size - 1] == PARSECONF_TOKEN_NESTED)) {
+            *errstr = "Repeating and nested types must be last";
+            return 1;
+        }
+        keyword->types[keyword->types_size++] = gen_types[t].type;
+
+        if (gen_types[t].type == PARSECONF_TOKEN_NESTED) {
+            if (tokens[++n].type == PARSECONF_TOKEN_END) {
+                *errstr = "Nested without a level";
+                return 1;
+            }
+            if (!gen_identifier(&tokens[n])) {
+                *errstr = "Level name is not a valid identifier";
+                return 1;
+            }
+            if (!(keyword->nested = gen_strdup(&tokens[n]))) {
+                *errstr = "Out of memory";
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Set a function of the last keyword, `which` selects the callback
+ */
+static int gen_function(gen_t* gen, const parseconf_token_t* token, int which, const char** errstr)
+{
+    gen_keyword_t* keyword;
+    char**         function;
+
+    if (!(keyword = gen_last(gen, errstr))) {
+        return 1;
+    }
+    if (!gen_identifier(token)) {
+        *errstr = "Function name is not a valid identifier";
+        return 1;
+    }
+    function = which == 2 ? &keyword->batch : which == 1 ? &keyword->remove : &keyword->callback;
+    if (*function) {
+        *errstr = "Function already given for the keyword";
+        return 1;
+    }
+    if (!(*function = gen_strdup(token))) {
+        *errstr = "Out of memory";
+        return 1;
+    }
+
+    return 0;
+}
+
+static int parse_callback(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    return gen_function(user, &tokens[1], 0, errstr);
+}
+
+static int parse_remove(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    return gen_function(user, &tokens[1], 1, errstr);
+}
+
+static int parse_batch(void* user, const parseconf_token_t* tokens, const char** errstr)
+{
+    gen_t* gen = user;
+
+    if (gen_function(gen, &tokens[1], 2, errstr)) {
+        return 1;
+    }
+
+    return parseconf_ulongint(&tokens[2], &gen_last(gen, errstr)->batch_size, errstr);
+}
+
+static parseconf_token_type_t tokens_string[]  = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_strings[] = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_STRINGS, PARSECONF_TOKEN_END };
+static parseconf_token_type_t tokens_batch[]   = { PARSECONF_TOKEN_STRING, PARSECONF_TOKEN_NUMBER, PARSECONF_TOKEN_END };
+
+static parseconf_syntax_t syntax[] = {
+    { "syntax", parse_syntax, tokens_string, 0, 0, 0, 0 },
+    { "level", parse_level, tokens_string, 0, 0, 0, 0 },
+    { "keyword", parse_keyword, tokens_strings, 0, 0, 0, 0 },
+    { "callback", parse_callback, tokens_string, 0, 0, 0, 0 },
+    { "batch", parse_batch, tokens_batch, 0, 0, 0, 0 },
+    { "remove", parse_remove, tokens_string, 0, 0, 0, 0 },
+    PARSECONF_SYNTAX_END
+};
+
+static void error_callback(void* user, parseconf_error_t error, size_t line, size_t token, const parseconf_token_t* tokens, const char* errstr)
+{
+    if (errstr && error != PARSECONF_ERROR_CALLBACK) {
+        fprintf(stderr, "In %s: ", errstr);
+    }
+
+    switch (error) {
+    case PARSECONF_ERROR_CALLBACK:
+        fprintf(stderr, "Description error at line %lu, %s\n", line, errstr);
+        break;
+
+    case PARSECONF_ERROR_FILE_ERRNO:
+        fprintf(stderr, "Unable to read description\n");
+        break;
+
+    case PARSECONF_ERROR_UNKNOWN:
+        fprintf(stderr, "Description error at line %lu for argument %lu, unknown statement\n", line, token);
+        break;
+
+    default:
+        fprintf(stderr, "Description error at line %lu for argument %lu\n", line, token);
+        break;
+    }
+}
+
+/*
+ * Return if a level is nested in any keyword
+ */
+static int gen_used(const gen_t* gen, const gen_level_t* level)
+{
+    size_t l, k;
+
+    for (l = 0; l < gen->levels_size; l++) {
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            if (gen->levels[l].keywords[k].nested && !strcmp(gen->levels[l].keywords[k].nested, level->name)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Check the description as a whole, every nested level must exist, every
+ * level but the top must be nested and every keyword must have a callback
+ * or a nested level
+ */
+static int gen_check(gen_t* gen)
+{
+    size_t l, k;
+
+    if (!gen->name) {
+        fprintf(stderr, "Description has no syntax name\n");
+        return 1;
+    }
+    if (!gen->levels_size) {
+        fprintf(stderr, "Description has no levels\n");
+        return 1;
+    }
+    for (l = 0; l < gen->levels_size; l++) {
+        if (!gen->levels[l].keywords_size) {
+            fprintf(stderr, "Level %s has no keywords\n", gen->levels[l].name);
+            return 1;
+        }
+        if (l && !gen_used(gen, &gen->levels[l])) {
+            fprintf(stderr, "Level %s is not nested in any keyword\n", gen->levels[l].name);
+            return 1;
+        }
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            gen_keyword_t* keyword = &gen->levels[l].keywords[k];
+
+            if (keyword->nested && !gen_find(gen, keyword->nested)) {
+                fprintf(stderr, "Keyword %s in level %s uses undefined level %s\n", keyword->token, gen->levels[l].name, keyword->nested);
+                return 1;
+            }
+            if (!keyword->callback && !keyword->batch && !keyword->nested) {
+                fprintf(stderr, "Keyword %s in level %s has no callback\n", keyword->token, gen->levels[l].name);
+                return 1;
+            }
+            if (keyword->callback && keyword->batch) {
+                fprintf(stderr, "Keyword %s in level %s has both a callback and a batch callback\n", keyword->token, gen->levels[l].name);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Code generation
+ */
+
+/*
+ * Write a keyword as a C string literal
+ */
+static void gen_string(FILE* out, const char* s)
+{
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void gen_table(FILE* out, const gen_t* gen, const gen_level_t* level)
+{
+    if (level == gen->levels) {
+        fprintf(out, "%s_syntax", gen->name);
+    } else {
+        fprintf(out, "%s_%s_syntax", gen->name, level->name);
+    }
+}
+
+/*
+ * Declare each function once, a function can be used for more than one
+ * keyword and as both callback and remove callback
+ */
+static void gen_prototypes(FILE* out, const gen_t* gen)
+{
+    const char** declared;
+    size_t       size = 0, l, k, f, n;
+
+    for (l = 0; l < gen->levels_size; l++) {
+        size += gen->levels[l].keywords_size * 3;
+    }
+    if (!(declared = calloc(size, sizeof(char*)))) {
+        return;
+    }
+
+    for (size = 0, l = 0; l < gen->levels_size; l++) {
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            const gen_keyword_t* keyword     = &gen->levels[l].keywords[k];
+            const char*          function[3] = { keyword->callback, keyword->remove, keyword->batch };
+
+            for (f = 0; f < 3; f++) {
+                if (!function[f]) {
+                    continue;
+                }
+                for (n = 0; n < size && strcmp(declared[n], function[f]); n++)
+                    ;
+                if (n < size) {
+                    continue;
+                }
+                declared[size++] = function[f];
+
+                if (f == 2) {
+                    fprintf(out, "int %s(void* user, const parseconf_statement_t* statements, size_t size, size_t* failed, const char** errstr);\n", function[f]);
+                } else {
+                    fprintf(out, "int %s(void* user, const parseconf_token_t* tokens, const char** errstr);\n", function[f]);
+                }
+            }
+        }
+    }
+    fprintf(out, "\n");
+    free(declared);
+}
+
+static void gen_tables(FILE* out, const gen_t* gen)
+{
+    size_t l, k, t;
+
+    for (l = 0; l < gen->levels_size; l++) {
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            const gen_keyword_t* keyword = &gen->levels[l].keywords[k];
+
+            fprintf(out, "static const parseconf_token_type_t %s_tokens_%lu_%lu[] = {", gen->name, l, k);
+            for (t = 0; t < keyword->types_size; t++) {
+                fprintf(out, " %s,", gen_types[gen_type(keyword->types[t])].define);
+            }
+            fprintf(out, " PARSECONF_TOKEN_END };\n");
+        }
+    }
+    fprintf(out, "\n");
+
+    /*
+     * Declare the levels first since they can refer to each other
+     */
+    for (l = 1; l < gen->levels_size; l++) {
+        fprintf(out, "static const parseconf_syntax_t ");
+        gen_table(out, gen, &gen->levels[l]);
+        fprintf(out, "[%lu];\n", gen->levels[l].keywords_size + 1);
+    }
+    if (gen->levels_size > 1) {
+        fprintf(out, "\n");
+    }
+
+    for (l = 0; l < gen->levels_size; l++) {
+        fprintf(out, l ? "static const parseconf_syntax_t " : "const parseconf_syntax_t ");
+        gen_table(out, gen, &gen->levels[l]);
+        fprintf(out, "[%lu] = {\n", gen->levels[l].keywords_size + 1);
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            const gen_keyword_t* keyword = &gen->levels[l].keywords[k];
+
+            fprintf(out, "    { ");
+            gen_string(out, keyword->token);
+            fprintf(out, ", %s, %s_tokens_%lu_%lu, ", keyword->callback ? keyword->callback : "0", gen->name, l, k);
+            if (keyword->nested) {
+                gen_table(out, gen, gen_find((gen_t*)gen, keyword->nested));
+            } else {
+                fprintf(out, "0");
+            }
+            fprintf(out, ", %s, %lu, %s },\n", keyword->batch ? keyword->batch : "0", keyword->batch_size, keyword->remove ? keyword->remove : "0");
+        }
+        fprintf(out, "    PARSECONF_SYNTAX_END\n};\n\n");
+    }
+}
+
+static int gen_compare(const void* a, const void* b)
+{
+    const gen_keyword_t* const* ka = a;
+    const gen_keyword_t* const* kb = b;
+    size_t                      la = strlen((*ka)->token), lb = strlen((*kb)->token);
+
+    return la < lb ? -1 : la > lb ? 1 : strcmp((*ka)->token, (*kb)->token);
+}
+
+/*
+ * Keyword dispatch of a level, a switch on the length and a compare for
+ * each keyword of that length
+ */
+static int gen_level(FILE* out, const gen_t* gen, size_t l)
+{
+    const gen_level_t* level = &gen->levels[l];
+    gen_keyword_t**    sorted;
+    size_t             k, length = 0;
+
+    if (!(sorted = calloc(level->keywords_size, sizeof(gen_keyword_t*)))) {
+        return 1;
+    }
+    for (k = 0; k < level->keywords_size; k++) {
+        sorted[k] = &level->keywords[k];
+    }
+    qsort(sorted, level->keywords_size, sizeof(gen_keyword_t*), gen_compare);
+
+    fprintf(out, "    /* level %s */\n", level->name);
+    if (gen_used(gen, level)) {
+        fprintf(out, "level_%lu:\n", l);
+    }
+    fprintf(out, "    if (tokens[i].type != PARSECONF_TOKEN_STRING) {\n        *error = PARSECONF_ERROR_EXPECT_STRING;\n        goto fail;\n    }\n");
+    fprintf(out, "    switch (tokens[i].length) {\n");
+    for (k = 0; k < level->keywords_size; k++) {
+        if (strlen(sorted[k]->token) != length) {
+            if (length) {
+                fprintf(out, "        break;\n");
+            }
+            length = strlen(sorted[k]->token);
+            fprintf(out, "    case %lu:\n", length);
+        }
+        fprintf(out, "        if (!memcmp(tokens[i].token, ");
+        gen_string(out, sorted[k]->token);
+        fprintf(out, ", %lu))\n            goto keyword_%lu_%lu;\n", length, l, (size_t)(sorted[k] - level->keywords));
+    }
+    fprintf(out, "        break;\n    }\n    *error = PARSECONF_ERROR_UNKNOWN;\n    goto fail;\n\n");
+    free(sorted);
+
+    return 0;
+}
+
+/*
+ * Argument checks of a keyword, fixed types are unrolled and a repeating
+ * type is a loop over the rest of the tokens. Like parse_check() a
+ * statement may end before all types are checked.
+ */
+static void gen_keyword(FILE* out, const gen_t* gen, size_t l, size_t k)
+{
+    const gen_keyword_t* keyword = &gen->levels[l].keywords[k];
+    size_t               t, type, fixed = 0;
+
+    fprintf(out, "    /* %s */\nkeyword_%lu_%lu:\n    i++;\n", keyword->token, l, k);
+    for (t = 0; t < keyword->types_size; t++) {
+        type = gen_type(keyword->types[t]);
+
+        if (keyword->types[t] == PARSECONF_TOKEN_NESTED) {
+            fprintf(out, "    if (i < size)\n        goto level_%lu;\n", (size_t)(gen_find((gen_t*)gen, keyword->nested) - gen->levels));
+        } else if (gen_repeat(keyword->types[t])) {
+            fprintf(out, "    for (; i < size; i++) {\n        if (%s) {\n            *error = %s;\n            goto fail;\n        }\n    }\n", gen_types[type].check, gen_types[type].error);
+        } else {
+            fprintf(out, "    if (i == size)\n        goto keyword_%lu_%lu_end;\n", l, k);
+            fprintf(out, "    if (%s) {\n        *error = %s;\n        goto fail;\n    }\n    i++;\n", gen_types[type].check, gen_types[type].error);
+            fixed++;
+        }
+    }
+    if (fixed) {
+        fprintf(out, "keyword_%lu_%lu_end:\n", l, k);
+    }
+
+    if (!keyword->callback && !keyword->batch) {
+        fprintf(out, "    *error = PARSECONF_ERROR_NO_CALLBACK;\n    goto fail;\n\n");
+        return;
+    }
+    fprintf(out, "    *syntax = &");
+    gen_table(out, gen, &gen->levels[l]);
+    fprintf(out, "[%lu];\n    goto done;\n\n", k);
+}
+
+static int gen_source(FILE* out, const gen_t* gen, const char* description, const char* header)
+{
+    size_t l, k;
+
+    fprintf(out, "/*\n * Generated by parsegen from %s, do not edit\n */\n\n", description);
+    fprintf(out, "#include \"%s\"\n\n", header ? header : "parseconf.h");
+    fprintf(out, "#include <string.h>\n\n");
+
+    gen_prototypes(out, gen);
+    gen_tables(out, gen);
+
+    fprintf(out, "int %s_check(const parseconf_token_t* tokens, size_t size, const parseconf_syntax_t** syntax, parseconf_error_t* error, size_t* token)\n{\n", gen->name);
+    fprintf(out, "    size_t i = 0;\n\n");
+    fprintf(out, "    if (!tokens || !size) {\n        *error = PARSECONF_ERROR_INTERNAL;\n        goto fail;\n    }\n\n");
+    for (l = 0; l < gen->levels_size; l++) {
+        if (gen_level(out, gen, l)) {
+            return 1;
+        }
+        for (k = 0; k < gen->levels[l].keywords_size; k++) {
+            gen_keyword(out, gen, l, k);
+        }
+    }
+    fprintf(out, "done:\n    *token = i;\n    return PARSECONF_OK;\n\n");
+    fprintf(out, "fail:\n    *token = i;\n    return PARSECONF_ERROR;\n}\n");
+
+    return ferror(out);
+}
+
+static int gen_header(FILE* out, const gen_t* gen, const char* description, const char* header)
+{
+    fprintf(out, "/*\n * Generated by parsegen from %s, do not edit\n */\n\n", description);
+    fprintf(out, "#ifndef __%s_syntax_h\n#define __%s_syntax_h\n\n", gen->name, gen->name);
+    fprintf(out, "#include \"parseconf.h\"\n\n");
+    fprintf(out, "extern const parseconf_syntax_t %s_syntax[];\n\n", gen->name);
+    fprintf(out, "int %s_check(const parseconf_token_t* tokens, size_t size, const parseconf_syntax_t** syntax, parseconf_error_t* error, size_t* token);\n\n", gen->name);
+    fprintf(out, "#endif /* __%s_syntax_h */\n", gen->name);
+
+    return ferror(out);
+}
+
+static int gen_write(const char* file, int (*write)(FILE*, const gen_t*, const char*, const char*), const gen_t* gen, const char* description, const char* header)
+{
+    FILE* out = stdout;
+    int   err;
+
+    if (file && !(out = fopen(file, "w"))) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return 1;
+    }
+    err = write(out, gen, description, header);
+    if (out != stdout && fclose(out)) {
+        err = 1;
+    }
+    if (err) {
+        fprintf(stderr, "Unable to write %s\n", file ? file : "output");
+    }
+
+    return err;
+}
+
+int main(int argc, char** argv)
+{
+    int         opt, err;
+    const char *output = 0, *header = 0, *description, *include = 0;
+    gen_t       gen;
+
+    while ((opt = getopt(argc, argv, "o:H:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            output = optarg;
+            break;
+        case 'H':
+            header = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage();
+        return 1;
+    }
+    description = argv[optind];
+
+    memset(&gen, 0, sizeof(gen));
+    if ((err = parseconf_file(&gen, description, syntax, error_callback)) != PARSECONF_OK) {
+        fprintf(stderr, "parseconf_file(%s): %s\n", description, parseconf_strerror(err));
+        gen_free(&gen);
+        return 1;
+    }
+    if (gen_check(&gen)) {
+        gen_free(&gen);
+        return 1;
+    }
+    if (strrchr(description, '/')) {
+        description = strrchr(description, '/') + 1;
+    }
+    if (header) {
+        include = strrchr(header, '/') ? strrchr(header, '/') + 1 : header;
+    }
+
+    err = (header && gen_write(header, gen_header, &gen, description, 0)) || gen_write(output, gen_source, &gen, description, include);
+    gen_free(&gen);
+
+    return err ? 1 : 0;
+}
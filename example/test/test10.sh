@@ -0,0 +1,33 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+awk 'BEGIN { for (i = 0; i < 2000; i++) print "example " i ";" }' >test10.conf
+
+for limits in 0,0,0,0,0 20,0,0,0,0 0,8,0,0,0 0,0,100,0,0 0,0,0,5,0; do
+    echo "limits $limits"
+    ../example -l "$limits" "$srcdir/test2.conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g"
+done >test10.out
+
+echo "limits 0,0,0,0,1" >>test10.out
+../example -l 0,0,0,0,1 test10.conf 2>>test10.out >/dev/null
+
+diff test10.out "$srcdir/test10.gold"
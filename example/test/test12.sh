@@ -0,0 +1,28 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+
+../example "$srcdir/test12.conf" >test12.out 2>/dev/null || true
+../example "$srcdir/test12.conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g" >>test12.out
+../example -x -g "$srcdir/test12.conf" >>test12.out 2>/dev/null || true
+
+diff test12.out "$srcdir/test12.gold"
@@ -0,0 +1,32 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+
+for mode in -f -m "-c test13.cache" "-c test13.cache" "-x -g"; do
+    ../example $mode "$srcdir/test13.conf"
+done >test13.out 2>&1
+
+for text in "listen 1.2.3.256 53;" "listen host 53;" "listen 10.0.0.0/8 53;" \
+    "allow 10.0.0.0/33;" "allow 01.2.3.4;" "allow 1.2.3.4/08;" "allow 1::2::3;" \
+    "allow 1:2:3:4:5:6:7:8::;" "allow 1:2:3:4:5:6:7;" "allow 12345::;" \
+    "allow 1.2.3.4 any;"; do
+    ../example -t "$text" 2>&1 || true
+done >>test13.out
+
+diff test13.out "$srcdir/test13.gold"
@@ -0,0 +1,31 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+
+for mode in -f -m "-c test14.cache" "-c test14.cache" "-x -g"; do
+    ../example $mode "$srcdir/test14.conf"
+done >test14.out 2>&1
+
+for text in "timeout 30;" "timeout 64k;" "timeout 1.5s;" "timeout 30S;" \
+    "timeout 18446744073709551616ns;" "timeout 213503982335d;" "buffer 5m;" \
+    "buffer 16777216T;" "buffer 64kb;" "buffer 99999999999999999999B;"; do
+    ../example -t "$text" 2>&1 || true
+done >>test14.out
+
+diff test14.out "$srcdir/test14.gold"
@@ -0,0 +1,30 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+
+text=$(printf 'example 1;\r\n\r\n\texample "two" 2; example 3;\n# comment\n  \t\nnested example 4; # trailing\r\nexample 5;')
+error=$(printf 'example 1;\nexample 2;\n\nexample 3\nexample 4;')
+
+../example -t "$text" >test15.out 2>&1
+../example -S -t "$text" >>test15.out 2>&1
+../example -x -t "$text" "$text" >>test15.out 2>&1
+../example -t "$error" >>test15.out 2>/dev/null || true
+../example -t "$error" 2>&1 >/dev/null | head -1 >>test15.out
+
+diff test15.out "$srcdir/test15.gold"
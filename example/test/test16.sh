@@ -0,0 +1,28 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+
+# A failed callback keeps what was applied, so the statements that were not
+# added or removed are tried again by the next reload
+../example -r "$srcdir/test16-a.conf" "$srcdir/test16-b.conf" \
+    "$srcdir/test16-b.conf" "$srcdir/test16-c.conf" \
+    "$srcdir/test16-a.conf" "$srcdir/test16-a.conf" \
+    "$srcdir/test16-d.conf" >test16.out 2>/dev/null
+
+diff test16.out "$srcdir/test16.gold"
@@ -0,0 +1,43 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+rm -f test17.cache test17-error.cache
+
+# Includes are handled by every way of parsing a file
+for opt in -m "-p 2" -r; do
+    echo "$opt"
+    ../example $opt "$srcdir/test6.conf"
+    for conf in test6-cycle.conf test6-error.conf; do
+        ../example $opt "$srcdir/$conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g"
+    done
+done >test17.out
+
+# The cache is used twice so it is both written and read
+for n in 1 2; do
+    echo "-c"
+    ../example -c test17.cache "$srcdir/test6.conf"
+    for conf in test6-cycle.conf test6-error.conf; do
+        ../example -c test17-error.cache "$srcdir/$conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g"
+    done
+done >>test17.out
+
+diff test17.out "$srcdir/test17.gold"
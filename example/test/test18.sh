@@ -0,0 +1,51 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+# Parsing with threads gives the same output as parsing with one thread,
+# also with statistics, interned strings, kept tokens and limits
+for opt in -S -i -a "-l 0,0,0,0,0" "-l 30,0,0,0,0" "-l 0,8,0,0,0" "-l 0,0,100,0,0" "-l 0,0,0,5,0"; do
+    for conf in test2.conf test6.conf test2-error.conf test6-error.conf; do
+        case "$opt $conf" in
+        "-S "*-error.conf)
+            # After an error the statistics include the rest of the chunk
+            continue
+            ;;
+        esac
+        ../example $opt "$srcdir/$conf" >test18.serial 2>&1
+        ../example -p 4 $opt "$srcdir/$conf" >test18.parallel 2>&1
+        cmp test18.serial test18.parallel
+        echo "$opt $conf"
+        sed "s%$srcdir_re/%%g" test18.parallel
+    done
+done >test18.out
+
+# Text is parsed with threads too
+text=$(cat "$srcdir/test2.conf")
+for opt in "" -S; do
+    ../example $opt -t "$text" >test18.serial 2>&1
+    ../example -p 4 $opt -t "$text" >test18.parallel 2>&1
+    cmp test18.serial test18.parallel
+    echo "-t $opt"
+    cat test18.parallel
+done >>test18.out
+
+diff test18.out "$srcdir/test18.gold"
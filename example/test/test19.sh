@@ -0,0 +1,37 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+rm -f test19.cache
+
+# The tokens given with an error, for a syntax error they are the complete
+# tokens before the one that failed
+for text in 'example "unterminated' 'example one "two" "thr' '"abc' 'example "a""b";' 'unknown 1 "two";'; do
+    echo "-t $text"
+    ../example -e -t "$text" 2>&1 >/dev/null
+done >test19.out
+
+for opt in -f -m "-p 2" -s "-c test19.cache" "-c test19.cache"; do
+    echo "$opt"
+    ../example -e $opt "$srcdir/test19.conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g"
+done >>test19.out
+
+diff test19.out "$srcdir/test19.gold"
@@ -0,0 +1,31 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+for mode in -f -m -s "-p 4" "-c test2.cache" "-c test2.cache" -a -i; do
+    ../example $mode "$srcdir/test2.conf"
+    ../example $mode "$srcdir/test2-error.conf" 2>&1 >/dev/null | sed 's%(.*/test2-error.conf)%(test2-error.conf)%'
+done >test2.out
+
+# A damaged cache is not used, here the end token of the last statement is
+# changed to a string so its tokens run past the end of the cache
+size=$(wc -c <test2.cache)
+printf '\001' | dd of=test2.cache bs=1 seek=$((size - 24)) conv=notrunc 2>/dev/null
+../example -c test2.cache "$srcdir/test2.conf" >>test2.out
+
+diff test2.out "$srcdir/test2.gold"
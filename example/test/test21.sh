@@ -0,0 +1,33 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# A file rewritten in place with its old size and modification time is
+# parsed again with -c, with -C the statements of the old content are
+# replayed on the new one
+rm -f test21.cache test21-stat.cache
+printf 'example "ab";\n' >test21.conf
+touch -t 202001010000 test21.conf
+../example -c test21.cache test21.conf >test21.out
+../example -C test21-stat.cache test21.conf >>test21.out
+printf 'example 12 3;\n' >test21.conf
+touch -t 202001010000 test21.conf
+../example -c test21.cache test21.conf >>test21.out
+../example -C test21-stat.cache test21.conf >>test21.out
+
+diff test21.out "$srcdir/test21.gold"
@@ -0,0 +1,29 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+../example -d 1 "$srcdir/test7.d" >test7.out
+../example -d 4 "$srcdir/test7.d" >>test7.out
+../example -S -d 1 "$srcdir/test7.d" >>test7.out
+../example -S -d 4 "$srcdir/test7.d" >>test7.out
+../example -d 0 "$srcdir/test7-error.d" 2>&1 | sed "s%$srcdir_re/%%g" >>test7.out
+
+diff test7.out "$srcdir/test7.gold"
@@ -0,0 +1,30 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+# Escape $srcdir to strip it from paths in messages, it may be "."
+srcdir_re=$(printf '%s\n' "$srcdir" | sed 's/[]%.*^$[\\]/\\&/g')
+
+../example -x "$srcdir/test2.conf" "$srcdir/test6.conf" "$srcdir/test2.conf" >test8.out
+
+../example -x -t "nested example 1;" "example 1 2 3;" \
+    "nested nested example nested;" >>test8.out
+
+../example -x "$srcdir/test2.conf" "$srcdir/test2-error.conf" 2>&1 >/dev/null | sed "s%$srcdir_re/%%g" >>test8.out
+
+diff test8.out "$srcdir/test8.gold"
@@ -0,0 +1,60 @@
+# Author Jerry Lundström <jerry@dns-oarc.net>
+# Copyright (c) 2017, OARC, Inc.
+# All rights reserved.
+#
+# This file is part of parseconf.
+#
+# parseconf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# parseconf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with parseconf.  If not, see <http://www.gnu.org/licenses/>.
+
+wait_for() {
+    n=0
+    while ! grep -q "$1" "$2"; do
+        if ! kill -0 $pid 2>/dev/null; then
+            # Exits with 77 at once if watching is not supported
+            wait $pid
+            if [ $? -eq 77 ]; then
+                exit 77
+            fi
+            exit 1
+        fi
+        n=`expr $n + 1`
+        if [ $n -gt 100 ]; then
+            kill $pid
+            exit 1
+        fi
+        sleep 0.1
+    done
+}
+
+rm -f test9.conf test9.new test9.out test9.err
+cat "$srcdir/test5-a.conf" >test9.conf
+
+../example -w 2 test9.conf >test9.out 2>test9.err &
+pid=$!
+wait_for "^watching" test9.out
+
+cat "$srcdir/test5-b.conf" >test9.new
+mv test9.new test9.conf
+wait_for "^snapshot 1" test9.out
+
+cat "$srcdir/test2-error.conf" >test9.new
+mv test9.new test9.conf
+wait_for "error" test9.err
+
+cat "$srcdir/test5-a.conf" >test9.new
+mv test9.new test9.conf
+wait $pid
+
+cat test9.err >>test9.out
+diff test9.out "$srcdir/test9.gold"
@@ -26,10 +26,38 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+#include <locale.h>
+#include <langinfo.h>
 #ifdef __FreeBSD__
 #define _WITH_GETLINE
 #endif
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <glob.h>
+#include <dirent.h>
+#include <errno.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+#if PARSECONF_ENABLE_WATCH && !PARSECONF_ENABLE_THREADS
+#error "PARSECONF_ENABLE_WATCH needs PARSECONF_ENABLE_THREADS"
+#endif
+#if PARSECONF_ENABLE_THREADS
+#include <pthread.h>
+#endif
+#if PARSECONF_ENABLE_WATCH
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 /*
  * Version
@@ -57,548 +85,5497 @@ inline int parseconf_version_patch(void)
 }
 
 /*
- * Parsing functions
+ * Syntax compiling
+ *
+ * Each level of the syntax, the top level and every distinct nested one, is
+ * compiled into an open addressing hash table of its keywords so that looking
+ * up the keyword of a statement is done with one hash and an exact length
+ * compare instead of scanning the table.
+ *
+ * The token types of each entry are compiled into states, each with a mask
+ * of the token types it accepts, if it repeats or is nested and the error
+ * for a token it does not accept, so checking a token is one lookup and one
+ * AND. `max` is the number of tokens, including the keyword, that are
+ * checked or -1 if the last state repeats or is nested.
+ *
+ * There is no minimum arity. A statement may end before all states are
+ * checked and the callback gets the tokens it has, callbacks count their
+ * tokens themselves for optional arguments. Refusing such statements
+ * would break configurations that parse today.
+ *
+ * The syntax is validated when compiled, unknown token types, NESTED without
+ * a nested syntax and entries without a callback which are not nested fail
+ * with PARSECONF_EINVAL instead of on every matching statement.
+ *
+ * `classify` of the top level has the flags of all states that need the
+ * tokenizer to do more than find the token, such as parsing addresses, so
+ * syntax that does not use them is tokenized as before.
  */
 
-static int parse_token(const char** conf, size_t* length, parseconf_token_t* token)
-{
-    int quoted = 0, end = 0;
+#define SYNTAX_ACCEPT(type) (1U << (type))
+#define SYNTAX_ACCEPT_ADDRESS (SYNTAX_ACCEPT(PARSECONF_TOKEN_IPADDR) | SYNTAX_ACCEPT(PARSECONF_TOKEN_PREFIX))
+#define SYNTAX_ACCEPT_STRING (SYNTAX_ACCEPT(PARSECONF_TOKEN_STRING) | SYNTAX_ACCEPT_ADDRESS | SYNTAX_ACCEPT(PARSECONF_TOKEN_DURATION) | SYNTAX_ACCEPT(PARSECONF_TOKEN_SIZE))
+#define SYNTAX_ACCEPT_ANY (SYNTAX_ACCEPT_STRING | SYNTAX_ACCEPT(PARSECONF_TOKEN_QSTRING) | SYNTAX_ACCEPT(PARSECONF_TOKEN_NUMBER) | SYNTAX_ACCEPT(PARSECONF_TOKEN_FLOAT))
+#define SYNTAX_REPEAT 0x01
+#define SYNTAX_NESTED 0x02
+#define SYNTAX_ADDRESS 0x04
+#define SYNTAX_DURATION 0x08
+#define SYNTAX_SIZE 0x10
+#define SYNTAX_CLASSIFY (SYNTAX_ADDRESS | SYNTAX_DURATION | SYNTAX_SIZE)
 
-    if (!conf || !*conf || !length || !token) {
-        return PARSECONF_EINVAL;
-    }
-    if (!*length) {
-        return PARSECONF_ERROR;
-    }
-    if (**conf == ' ' || **conf == '\t' || **conf == ';' || !**conf || **conf == '\n' || **conf == '\r') {
-        return PARSECONF_ERROR;
-    }
-    if (**conf == '#') {
-        return PARSECONF_COMMENT;
-    }
+typedef struct syntax_state   syntax_state_t;
+typedef struct syntax_keyword syntax_keyword_t;
+typedef struct syntax_level   syntax_level_t;
 
-    if (**conf == '"') {
-        quoted = 1;
-        (*conf)++;
-        (*length)--;
-        token->type = PARSECONF_TOKEN_QSTRING;
-    } else {
-        token->type = PARSECONF_TOKEN_NUMBER;
-    }
+struct syntax_state {
+    unsigned int      accept, flags;
+    parseconf_error_t error;
+};
 
-    token->token  = *conf;
-    token->length = 0;
+static const syntax_state_t syntax_states[PARSECONF_TOKEN_TYPES] = {
+    [PARSECONF_TOKEN_STRING]   = { SYNTAX_ACCEPT_STRING, 0, PARSECONF_ERROR_EXPECT_STRING },
+    [PARSECONF_TOKEN_QSTRING]  = { SYNTAX_ACCEPT(PARSECONF_TOKEN_QSTRING), 0, PARSECONF_ERROR_EXPECT_QSTRING },
+    [PARSECONF_TOKEN_NUMBER]   = { SYNTAX_ACCEPT(PARSECONF_TOKEN_NUMBER), 0, PARSECONF_ERROR_EXPECT_NUMBER },
+    [PARSECONF_TOKEN_FLOAT]    = { SYNTAX_ACCEPT(PARSECONF_TOKEN_FLOAT), 0, PARSECONF_ERROR_EXPECT_FLOAT },
+    [PARSECONF_TOKEN_STRINGS]  = { SYNTAX_ACCEPT_STRING, SYNTAX_REPEAT, PARSECONF_ERROR_EXPECT_STRING },
+    [PARSECONF_TOKEN_QSTRINGS] = { SYNTAX_ACCEPT(PARSECONF_TOKEN_QSTRING), SYNTAX_REPEAT, PARSECONF_ERROR_EXPECT_QSTRING },
+    [PARSECONF_TOKEN_NUMBERS]  = { SYNTAX_ACCEPT(PARSECONF_TOKEN_NUMBER), SYNTAX_REPEAT, PARSECONF_ERROR_EXPECT_NUMBER },
+    [PARSECONF_TOKEN_FLOATS]   = { SYNTAX_ACCEPT(PARSECONF_TOKEN_FLOAT), SYNTAX_REPEAT, PARSECONF_ERROR_EXPECT_FLOAT },
+    [PARSECONF_TOKEN_ANY]      = { SYNTAX_ACCEPT_ANY, SYNTAX_REPEAT, PARSECONF_ERROR_EXPECT_ANY },
+    [PARSECONF_TOKEN_NESTED]   = { SYNTAX_ACCEPT(PARSECONF_TOKEN_STRING), SYNTAX_NESTED, PARSECONF_ERROR_EXPECT_STRING },
+    [PARSECONF_TOKEN_IPADDR]   = { SYNTAX_ACCEPT(PARSECONF_TOKEN_IPADDR), SYNTAX_ADDRESS, PARSECONF_ERROR_EXPECT_IPADDR },
+    [PARSECONF_TOKEN_PREFIX]   = { SYNTAX_ACCEPT_ADDRESS, SYNTAX_ADDRESS, PARSECONF_ERROR_EXPECT_PREFIX },
+    [PARSECONF_TOKEN_IPADDRS]  = { SYNTAX_ACCEPT(PARSECONF_TOKEN_IPADDR), SYNTAX_REPEAT | SYNTAX_ADDRESS, PARSECONF_ERROR_EXPECT_IPADDR },
+    [PARSECONF_TOKEN_PREFIXES] = { SYNTAX_ACCEPT_ADDRESS, SYNTAX_REPEAT | SYNTAX_ADDRESS, PARSECONF_ERROR_EXPECT_PREFIX },
+    [PARSECONF_TOKEN_DURATION] = { SYNTAX_ACCEPT(PARSECONF_TOKEN_DURATION), SYNTAX_DURATION, PARSECONF_ERROR_EXPECT_DURATION },
+    [PARSECONF_TOKEN_SIZE]     = { SYNTAX_ACCEPT(PARSECONF_TOKEN_SIZE), SYNTAX_SIZE, PARSECONF_ERROR_EXPECT_SIZE }
+};
 
-    for (; **conf && length; (*conf)++, (*length)--) {
-        if (quoted && **conf == '"') {
-            end    = 1;
-            quoted = 0;
-            continue;
-        } else if ((!quoted || end) && (**conf == ' ' || **conf == '\t' || **conf == ';')) {
-            while (length && (**conf == ' ' || **conf == '\t')) {
-                (*conf)++;
-                (*length)--;
-            }
-            if (**conf == ';') {
-                (*conf)++;
-                (*length)--;
-                return PARSECONF_LAST;
-            }
-            return PARSECONF_OK;
-        } else if (end || **conf == '\n' || **conf == '\r' || !**conf) {
-            return PARSECONF_ERROR;
-        }
+struct syntax_keyword {
+    const parseconf_syntax_t* syntax;
+    size_t                    length;
+    unsigned int              hash;
+    const syntax_level_t*     nested;
+    const syntax_state_t*     states;
+    size_t                    max;
+};
 
-        if (**conf == '.' && token->type == PARSECONF_TOKEN_NUMBER) {
-            token->type = PARSECONF_TOKEN_FLOAT;
-        } else if (**conf < '0' || **conf > '9') {
-            switch (token->type) {
-            case PARSECONF_TOKEN_NUMBER:
-                token->type = PARSECONF_TOKEN_STRING;
-                break;
-            case PARSECONF_TOKEN_FLOAT:
-                return PARSECONF_ERROR;
-            default:
-                break;
-            }
-        }
+struct syntax_level {
+    syntax_level_t*           next;
+    const parseconf_syntax_t* syntax;
+    size_t                    entries, mask, index;
+    syntax_keyword_t*         keywords;
+    syntax_state_t*           states;
+    unsigned int              classify;
+};
+
+static inline unsigned int syntax_hash(const char* token, size_t length)
+{
+    unsigned int hash = 2166136261U;
 
-        token->length++;
+    for (; length; token++, length--) {
+        hash ^= (unsigned char)*token;
+        hash *= 16777619U;
     }
 
-    return PARSECONF_ERROR;
+    return hash;
 }
 
-static int parse_tokens(void* user, const parseconf_syntax_t* syntax, const parseconf_token_t* tokens, size_t token_size, size_t line, parseconf_error_callback_t error_callback)
+static void syntax_free(syntax_level_t* levels)
 {
-    const parseconf_syntax_t*     syntaxp;
-    const parseconf_token_type_t* type;
-    size_t                        i;
-    const char*                   errstr = "Syntax error or invalid arguments";
+    syntax_level_t* next;
 
-    if (!syntax || !tokens || !token_size) {
-        if (error_callback)
-            error_callback(user, PARSECONF_ERROR_INTERNAL, line, 0, 0, 0);
-        return PARSECONF_ERROR;
+    for (; levels; levels = next) {
+        next = levels->next;
+        free(levels->keywords);
+        free(levels->states);
+        free(levels);
     }
+}
 
-    if (tokens[0].type != PARSECONF_TOKEN_STRING) {
-        if (error_callback)
-            error_callback(user, PARSECONF_ERROR_EXPECT_STRING, line, 0, tokens, 0);
-        return PARSECONF_ERROR;
-    }
+/*
+ * Validate an entry and return the number of states it compiles into,
+ * states after a repeating or nested one are never reached and not counted
+ */
+static int syntax_validate(const parseconf_syntax_t* syntax, size_t* states)
+{
+    const parseconf_token_type_t* type;
+    int                           nested = 0;
 
-    for (syntaxp = syntax; syntaxp->token; syntaxp++) {
-        if (!strncmp(tokens[0].token, syntaxp->token, tokens[0].length)) {
+    if (!syntax->syntax) {
+        return PARSECONF_EINVAL;
+    }
+    for (*states = 0, type = syntax->syntax; *type != PARSECONF_TOKEN_END; type++) {
+        if (*type >= PARSECONF_TOKEN_TYPES || !syntax_states[*type].accept) {
+            return PARSECONF_EINVAL;
+        }
+        (*states)++;
+        if (syntax_states[*type].flags & SYNTAX_NESTED) {
+            if (!syntax->nested) {
+                return PARSECONF_EINVAL;
+            }
+            nested = 1;
+            break;
+        }
+        if (syntax_states[*type].flags & SYNTAX_REPEAT) {
             break;
         }
     }
-    if (!syntaxp->token) {
-        if (error_callback)
-            error_callback(user, PARSECONF_ERROR_UNKNOWN, line, 0, tokens, 0);
-        return PARSECONF_ERROR;
+    if (!syntax->callback && !syntax->batch_callback && !nested) {
+        return PARSECONF_EINVAL;
     }
 
-    for (type = syntaxp->syntax, i = 1; *type != PARSECONF_TOKEN_END && i < token_size; i++) {
-        if (*type == PARSECONF_TOKEN_NESTED) {
-            if (!syntaxp->nested) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_NO_NESTED, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
-
-            if (tokens[i].type != PARSECONF_TOKEN_STRING) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_STRING, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
+    return PARSECONF_OK;
+}
 
-            for (syntaxp = syntaxp->nested; syntaxp->token; syntaxp++) {
-                if (!strncmp(tokens[i].token, syntaxp->token, tokens[i].length)) {
-                    break;
-                }
-            }
-            if (!syntaxp->token) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_UNKNOWN, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
+static int syntax_compile_level(syntax_level_t** levels, const parseconf_syntax_t* syntax, syntax_level_t** compiled)
+{
+    syntax_level_t **         tail, *level, *nested;
+    syntax_keyword_t*         keyword;
+    syntax_state_t*           state;
+    const parseconf_syntax_t* syntaxp;
+    size_t                    size, n, states, total = 0, index = 0;
+    int                       ret;
 
-            type = syntaxp->syntax;
-            continue;
+    /*
+     * Nested syntax can be shared between keywords or be recursive so only
+     * compile each level once, new levels are added last so the top level
+     * is always first. Entries are also numbered across all levels, `index`
+     * is the number of the first entry in the level.
+     */
+    for (tail = levels; *tail; tail = &(*tail)->next) {
+        if ((*tail)->syntax == syntax) {
+            *compiled = *tail;
+            return PARSECONF_OK;
         }
+        index += (*tail)->entries;
+    }
 
-        if (*type == PARSECONF_TOKEN_STRINGS) {
-            if (tokens[i].type != PARSECONF_TOKEN_STRING) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_STRING, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
-            continue;
-        }
-        if (*type == PARSECONF_TOKEN_QSTRINGS) {
-            if (tokens[i].type != PARSECONF_TOKEN_QSTRING) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_QSTRING, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
-            continue;
+    for (n = 0, syntaxp = syntax; syntaxp->token; syntaxp++) {
+        if ((ret = syntax_validate(syntaxp, &states)) != PARSECONF_OK) {
+            return ret;
         }
-        if (*type == PARSECONF_TOKEN_NUMBERS) {
-            if (tokens[i].type != PARSECONF_TOKEN_NUMBER) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_NUMBER, line, i, tokens, 0);
-                return PARSECONF_ERROR;
+        total += states;
+        n++;
+    }
+    for (size = 8; size < n * 2; size <<= 1)
+        ;
+
+    if (!(level = calloc(1, sizeof(syntax_level_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    if (!(level->keywords = calloc(size, sizeof(syntax_keyword_t)))
+        || (total && !(level->states = calloc(total, sizeof(syntax_state_t))))) {
+        free(level->keywords);
+        free(level);
+        return PARSECONF_ENOMEM;
+    }
+    level->syntax  = syntax;
+    level->entries = n;
+    level->mask    = size - 1;
+    level->index   = index;
+    *tail          = level;
+    state          = level->states;
+
+    for (syntaxp = syntax; syntaxp->token; syntaxp++) {
+        size_t                        length = strlen(syntaxp->token);
+        unsigned int                  hash   = syntax_hash(syntaxp->token, length);
+        const parseconf_token_type_t* type;
+
+        for (keyword = &level->keywords[hash & level->mask]; keyword->syntax; keyword = &level->keywords[(keyword - level->keywords + 1) & level->mask]) {
+            if (keyword->hash == hash && keyword->length == length && !memcmp(keyword->syntax->token, syntaxp->token, length)) {
+                break;
             }
-            continue;
         }
-        if (*type == PARSECONF_TOKEN_FLOATS) {
-            if (tokens[i].type != PARSECONF_TOKEN_FLOAT) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_FLOAT, line, i, tokens, 0);
-                return PARSECONF_ERROR;
-            }
+        if (keyword->syntax) {
+            /*
+             * Duplicate keyword, first one wins
+             */
             continue;
         }
-        if (*type == PARSECONF_TOKEN_ANY) {
-            if (tokens[i].type != PARSECONF_TOKEN_STRING && tokens[i].type != PARSECONF_TOKEN_NUMBER && tokens[i].type != PARSECONF_TOKEN_QSTRING && tokens[i].type != PARSECONF_TOKEN_FLOAT) {
-                if (error_callback)
-                    error_callback(user, PARSECONF_ERROR_EXPECT_ANY, line, i, tokens, 0);
-                return PARSECONF_ERROR;
+
+        keyword->syntax = syntaxp;
+        keyword->length = length;
+        keyword->hash   = hash;
+        keyword->states = state;
+        keyword->max    = 1;
+        for (type = syntaxp->syntax; *type != PARSECONF_TOKEN_END; type++) {
+            *state = syntax_states[*type];
+            level->classify |= state->flags & SYNTAX_CLASSIFY;
+            if (state++->flags & (SYNTAX_REPEAT | SYNTAX_NESTED)) {
+                keyword->max = (size_t)-1;
+                break;
             }
-            continue;
+            keyword->max++;
         }
-
-        if (tokens[i].type != *type) {
-            if (error_callback) {
-                parseconf_error_t err;
-                switch (*type) {
-                case PARSECONF_TOKEN_STRING:
-                    err = PARSECONF_ERROR_EXPECT_STRING;
-                    break;
-                case PARSECONF_TOKEN_NUMBER:
-                    err = PARSECONF_ERROR_EXPECT_NUMBER;
-                    break;
-                case PARSECONF_TOKEN_QSTRING:
-                    err = PARSECONF_ERROR_EXPECT_QSTRING;
-                    break;
-                case PARSECONF_TOKEN_FLOAT:
-                    err = PARSECONF_ERROR_EXPECT_FLOAT;
-                    break;
-                default:
-                    err = PARSECONF_ERROR_EXPECT_ANY;
-                }
-                error_callback(user, err, line, i, tokens, 0);
+        if (syntaxp->nested) {
+            if ((ret = syntax_compile_level(levels, syntaxp->nested, &nested)) != PARSECONF_OK) {
+                return ret;
             }
-            return PARSECONF_ERROR;
+            keyword->nested = nested;
         }
-        type++;
-    }
-
-    if (!syntaxp->callback) {
-        if (error_callback)
-            error_callback(user, PARSECONF_ERROR_NO_CALLBACK, line, i, tokens, 0);
-        return PARSECONF_ERROR;
-    }
-
-    if (syntaxp->callback(user, tokens, &errstr)) {
-        if (error_callback)
-            error_callback(user, PARSECONF_ERROR_CALLBACK, line, i, tokens, errstr);
-        return PARSECONF_ERROR;
     }
 
+    *compiled = level;
     return PARSECONF_OK;
 }
 
-/*
- * Value helpers
- */
-
-int parseconf_ulongint(const parseconf_token_t* token, unsigned long int* value, const char** errstr)
+static int syntax_compile(const parseconf_syntax_t* syntax, syntax_level_t** levels)
 {
-    char  buf[32];
-    char* endptr = 0;
+    syntax_level_t *compiled = 0, *level;
+    int             ret;
 
-    if (!token) {
-        return 1;
+    if ((ret = syntax_compile_level(&compiled, syntax, &level)) != PARSECONF_OK) {
+        syntax_free(compiled);
+        return ret;
     }
-    if (!value) {
-        return 1;
+    for (level = compiled->next; level; level = level->next) {
+        compiled->classify |= level->classify;
     }
 
-    if (token->length > (sizeof(buf) - 1)) {
-        if (errstr)
-            *errstr = "Too large value";
-        return 1;
-    }
-    if (!*(token->token)) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
-    }
+    *levels = compiled;
+    return PARSECONF_OK;
+}
 
-    memset(buf, 0, sizeof(buf));
-    memcpy(buf, token->token, token->length);
-    *value = strtoul(buf, &endptr, 10);
+static inline const syntax_keyword_t* syntax_lookup(const syntax_level_t* level, const parseconf_token_t* token)
+{
+    const syntax_keyword_t* keyword;
+    unsigned int            hash = syntax_hash(token->token, token->length);
 
-    if (!endptr || *endptr) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
+    for (keyword = &level->keywords[hash & level->mask]; keyword->syntax; keyword = &level->keywords[(keyword - level->keywords + 1) & level->mask]) {
+        if (keyword->hash == hash && keyword->length == token->length && !memcmp(keyword->syntax->token, token->token, token->length)) {
+            return keyword;
+        }
     }
 
     return 0;
 }
 
-int parseconf_ulonglongint(const parseconf_token_t* token, unsigned long long int* value, const char** errstr)
-{
-    char  buf[64];
-    char* endptr = 0;
+/*
+ * Parsing functions
+ */
 
-    if (!token) {
-        return 1;
-    }
-    if (!value) {
-        return 1;
-    }
+/*
+ * Character classes used by the tokenizer
+ */
 
-    if (token->length > (sizeof(buf) - 1)) {
-        if (errstr)
-            *errstr = "Too large value";
-        return 1;
-    }
-    if (!*(token->token)) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
-    }
+#define PARSE_SPACE 0x01
+#define PARSE_LAST 0x02
+#define PARSE_EOL 0x04
+#define PARSE_DIGIT 0x08
+#define PARSE_DOT 0x10
+#define PARSE_QUOTE 0x20
+#define PARSE_COMMENT 0x40
+#define PARSE_SEPARATOR (PARSE_SPACE | PARSE_LAST)
 
-    memset(buf, 0, sizeof(buf));
-    memcpy(buf, token->token, token->length);
-    *value = strtoull(buf, &endptr, 10);
+static const unsigned char parse_class[256] = {
+    [0]    = PARSE_EOL,
+    ['\n'] = PARSE_EOL,
+    ['\r'] = PARSE_EOL,
+    [' ']  = PARSE_SPACE,
+    ['\t'] = PARSE_SPACE,
+    [';']  = PARSE_LAST,
+    ['"']  = PARSE_QUOTE,
+    ['#']  = PARSE_COMMENT,
+    ['.']  = PARSE_DOT,
+    ['0']  = PARSE_DIGIT,
+    ['1']  = PARSE_DIGIT,
+    ['2']  = PARSE_DIGIT,
+    ['3']  = PARSE_DIGIT,
+    ['4']  = PARSE_DIGIT,
+    ['5']  = PARSE_DIGIT,
+    ['6']  = PARSE_DIGIT,
+    ['7']  = PARSE_DIGIT,
+    ['8']  = PARSE_DIGIT,
+    ['9']  = PARSE_DIGIT
+};
 
-    if (!endptr || *endptr) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
+/*
+ * Find the end of a token, for unquoted tokens that is the first separator
+ * or end of line and for quoted tokens the first quote or end of line.
+ * With SSE2 this is done 16 bytes at a time.
+ */
+static inline const unsigned char* parse_scan(const unsigned char* p, const unsigned char* end, int quoted)
+{
+    const unsigned char stop = quoted ? (PARSE_QUOTE | PARSE_EOL) : (PARSE_SEPARATOR | PARSE_EOL);
+
+#if defined(__SSE2__) && defined(__GNUC__)
+    const __m128i nl  = _mm_set1_epi8('\n');
+    const __m128i cr  = _mm_set1_epi8('\r');
+    const __m128i nul = _mm_setzero_si128();
+    const __m128i c1  = _mm_set1_epi8(quoted ? '"' : ' ');
+    const __m128i c2  = _mm_set1_epi8(quoted ? '"' : '\t');
+    const __m128i c3  = _mm_set1_epi8(quoted ? '"' : ';');
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, nul), _mm_or_si128(_mm_cmpeq_epi8(v, c1), _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, c3)))));
+        int mask = _mm_movemask_epi8(m);
+
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
     }
+#endif
 
-    return 0;
+    for (; p < end && !(parse_class[*p] & stop); p++)
+        ;
+
+    return p;
 }
 
-int parseconf_double(const parseconf_token_t* token, double* value, const char** errstr)
+/*
+ * Classify an unquoted token, only digits is a number and digits with one
+ * dot is a float. A dot followed by anything but digits is invalid and
+ * returns PARSECONF_TOKEN_END.
+ */
+static inline parseconf_token_type_t parse_type(const unsigned char* p, const unsigned char* end)
 {
-    char  buf[64];
-    char* endptr = 0;
-
-    if (!token) {
-        return 1;
-    }
-    if (!value) {
-        return 1;
+    for (; p < end && (parse_class[*p] & PARSE_DIGIT); p++)
+        ;
+    if (p == end) {
+        return PARSECONF_TOKEN_NUMBER;
     }
-
-    if (token->length > (sizeof(buf) - 1)) {
-        if (errstr)
-            *errstr = "Too large value";
-        return 1;
+    if (!(parse_class[*p] & PARSE_DOT)) {
+        return PARSECONF_TOKEN_STRING;
     }
-    if (!*(token->token)) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
+    for (p++; p < end && (parse_class[*p] & PARSE_DIGIT); p++)
+        ;
+    if (p == end) {
+        return PARSECONF_TOKEN_FLOAT;
     }
 
-    memset(buf, 0, sizeof(buf));
-    memcpy(buf, token->token, token->length);
-    *value = strtod(buf, &endptr);
+    return PARSECONF_TOKEN_END;
+}
 
-    if (!endptr || *endptr) {
-        if (errstr)
-            *errstr = "Invalid value";
-        return 1;
+/*
+ * Parse the dotted quad IPv4 address between `p` and `end` into `address`,
+ * octets are decimal without leading zeros
+ */
+static int parse_ipv4(const unsigned char* p, const unsigned char* end, unsigned char* address)
+{
+    unsigned int octet;
+    size_t       n, digits;
+
+    for (n = 0; n < 4; n++) {
+        if (n && (p == end || *p++ != '.')) {
+            return 1;
+        }
+        for (octet = 0, digits = 0; p < end && (parse_class[*p] & PARSE_DIGIT); p++, digits++) {
+            if (digits && !octet) {
+                return 1;
+            }
+            if ((octet = octet * 10 + (*p - '0')) > 255) {
+                return 1;
+            }
+        }
+        if (!digits) {
+            return 1;
+        }
+        address[n] = octet;
     }
 
-    return 0;
+    return p != end;
 }
 
-int parseconf_longdouble(const parseconf_token_t* token, long double* value, const char** errstr)
+static inline int parse_hex(unsigned char c)
 {
-    char  buf[128];
-    char* endptr = 0;
-
-    if (!token) {
-        return 1;
+    if (c >= '0' && c <= '9') {
+        return c - '0';
     }
-    if (!value) {
-        return 1;
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
     }
 
-    if (token->length > (sizeof(buf) - 1)) {
-        if (errstr)
-            *errstr = "Too large value";
-        return 1;
-    }
-    if (!*(token->token)) {
-        if (errstr)
-            *errstr = "Invalid value";
+    return -1;
+}
+
+/*
+ * Parse the IPv6 address between `p` and `end` into `address`, groups of up
+ * to 4 hex digits with at most one `::` and an optional IPv4 address as the
+ * last 32 bits. Zone indexes are not supported.
+ */
+static int parse_ipv6(const unsigned char* p, const unsigned char* end, unsigned char* address)
+{
+    const unsigned char* group;
+    size_t               n = 0, gap = (size_t)-1, digits;
+    unsigned int         value;
+    int                  hex;
+
+    if (end - p >= 2 && p[0] == ':' && p[1] == ':') {
+        gap = 0;
+        p += 2;
+        if (p == end) {
+            memset(address, 0, 16);
+            return 0;
+        }
+    } else if (p < end && *p == ':') {
         return 1;
     }
 
-    memset(buf, 0, sizeof(buf));
-    memcpy(buf, token->token, token->length);
-    *value = strtold(buf, &endptr);
+    for (;;) {
+        group = p;
+        for (value = 0, digits = 0; p < end && digits < 5 && (hex = parse_hex(*p)) >= 0; p++, digits++) {
+            value = (value << 4) | hex;
+        }
+        if (p < end && *p == '.') {
+            if (n > 12 || parse_ipv4(group, end, &address[n])) {
+                return 1;
+            }
+            n += 4;
+            break;
+        }
+        if (!digits || digits > 4 || n > 14) {
+            return 1;
+        }
+        address[n++] = value >> 8;
+        address[n++] = value;
+        if (p == end) {
+            break;
+        }
+        if (*p++ != ':') {
+            return 1;
+        }
+        if (p < end && *p == ':') {
+            if (gap != (size_t)-1) {
+                return 1;
+            }
+            gap = n;
+            if (++p == end) {
+                break;
+            }
+        } else if (p == end) {
+            return 1;
+        }
+    }
 
-    if (!endptr || *endptr) {
-        if (errstr)
-            *errstr = "Invalid value";
+    if (gap == (size_t)-1) {
+        return n != 16;
+    }
+    if (n == 16) {
+        /*
+         * `::` must stand for at least one group
+         */
         return 1;
     }
+    memmove(&address[16 - (n - gap)], &address[gap], n - gap);
+    memset(&address[gap], 0, 16 - n);
 
     return 0;
 }
 
 /*
- * Calls
+ * Parse an unquoted token as an IP address with an optional prefix length,
+ * on success the token becomes an IPADDR or PREFIX and is left untouched
+ * otherwise
  */
-
-int parseconf_file(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+static void parse_address(parseconf_token_t* token)
 {
-    FILE*             fp;
-    char*             buffer  = 0;
-    size_t            bufsize = 0;
-    const char*       buf;
-    size_t            s, i, line = 0;
-    parseconf_token_t tokens[PARSECONF_MAX_TOKENS];
-    int               ret, ret2;
+    const unsigned char *p = (const unsigned char*)token->token, *end = p + token->length, *slash;
+    unsigned char        address[16] = { 0 };
+    unsigned int         family, max, prefix;
 
-    if (!file) {
-        return PARSECONF_EINVAL;
+    if (parse_hex(*p) < 0 && *p != ':') {
+        return;
     }
-    if (!syntax) {
-        return PARSECONF_EINVAL;
+    if (!(slash = memchr(p, '/', token->length))) {
+        slash = end;
+    }
+    if (memchr(p, ':', slash - p)) {
+        if (parse_ipv6(p, slash, address)) {
+            return;
+        }
+        family = AF_INET6;
+        max    = 128;
+    } else {
+        if (parse_ipv4(p, slash, address)) {
+            return;
+        }
+        family = AF_INET;
+        max    = 32;
     }
 
+    prefix = max;
+    if (slash != end) {
+        for (p = slash + 1, prefix = 0; p < end && (parse_class[*p] & PARSE_DIGIT); p++) {
+            if (p > slash + 1 && !prefix) {
+                return;
+            }
+            if ((prefix = prefix * 10 + (*p - '0')) > max) {
+                return;
+            }
+        }
+        if (p == slash + 1 || p != end) {
+            return;
+        }
+    }
+
+    token->type   = slash != end ? PARSECONF_TOKEN_PREFIX : PARSECONF_TOKEN_IPADDR;
+    token->family = family;
+    token->prefix = prefix;
+    memcpy(token->data.address, address, sizeof(address));
+}
+
+/*
+ * Suffixes of durations and sizes and what they scale the number with
+ */
+
+typedef struct parse_unit parse_unit_t;
+struct parse_unit {
+    const char* suffix;
+    size_t      length;
+    uint64_t    scale;
+};
+
+static const parse_unit_t parse_durations[] = {
+    { "ns", 2, 1ULL },
+    { "us", 2, 1000ULL },
+    { "ms", 2, 1000000ULL },
+    { "s", 1, 1000000000ULL },
+    { "m", 1, 60 * 1000000000ULL },
+    { "h", 1, 3600 * 1000000000ULL },
+    { "d", 1, 86400 * 1000000000ULL },
+    { "w", 1, 604800 * 1000000000ULL },
+    { 0, 0, 0 }
+};
+
+static const parse_unit_t parse_sizes[] = {
+    { "B", 1, 1ULL },
+    { "k", 1, 1ULL << 10 },
+    { "K", 1, 1ULL << 10 },
+    { "M", 1, 1ULL << 20 },
+    { "G", 1, 1ULL << 30 },
+    { "T", 1, 1ULL << 40 },
+    { "kB", 2, 1ULL << 10 },
+    { "KB", 2, 1ULL << 10 },
+    { "MB", 2, 1ULL << 20 },
+    { "GB", 2, 1ULL << 30 },
+    { "TB", 2, 1ULL << 40 },
+    { 0, 0, 0 }
+};
+
+static inline const parse_unit_t* parse_unit_lookup(const parse_unit_t* unit, const unsigned char* p, size_t length)
+{
+    for (; unit->suffix; unit++) {
+        if (unit->length == length && !memcmp(unit->suffix, p, length)) {
+            return unit;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Parse an unquoted token as digits followed by a duration or size suffix,
+ * `classify` tells which of them the syntax uses. On success the token
+ * becomes a DURATION or SIZE with `value` converted and is left untouched
+ * if it is anything else or the value overflows.
+ */
+static void parse_unit(parseconf_token_t* token, unsigned int classify)
+{
+    const unsigned char *p = (const unsigned char*)token->token, *end = p + token->length;
+    const parse_unit_t*  unit;
+    uint64_t             value;
+
+    if (!(parse_class[*p] & PARSE_DIGIT)) {
+        return;
+    }
+    for (value = 0; p < end && (parse_class[*p] & PARSE_DIGIT); p++) {
+        if (value > (UINT64_MAX - (*p - '0')) / 10) {
+            return;
+        }
+        value = value * 10 + (*p - '0');
+    }
+
+    if ((classify & SYNTAX_DURATION) && (unit = parse_unit_lookup(parse_durations, p, end - p))) {
+        token->type = PARSECONF_TOKEN_DURATION;
+    } else if ((classify & SYNTAX_SIZE) && (unit = parse_unit_lookup(parse_sizes, p, end - p))) {
+        token->type = PARSECONF_TOKEN_SIZE;
+    } else {
+        return;
+    }
+    if (value > UINT64_MAX / unit->scale) {
+        token->type = PARSECONF_TOKEN_STRING;
+        return;
+    }
+    token->data.value = value * unit->scale;
+}
+
+/*
+ * Parse the next token, `classify` are the SYNTAX_ flags of the compiled
+ * syntax that tell which token types are classified beyond the basic ones
+ */
+static int parse_token(const char** conf, size_t* length, parseconf_token_t* token, unsigned int classify)
+{
+    const unsigned char *start, *p, *end;
+    int                  ret = PARSECONF_OK;
+
+    if (!conf || !*conf || !length || !token) {
+        return PARSECONF_EINVAL;
+    }
+    if (!*length) {
+        return PARSECONF_ERROR;
+    }
+
+    start = p = (const unsigned char*)*conf;
+    end       = p + *length;
+
+    if (parse_class[*p] & (PARSE_SEPARATOR | PARSE_EOL)) {
+        return PARSECONF_ERROR;
+    }
+    if (parse_class[*p] & PARSE_COMMENT) {
+        return PARSECONF_COMMENT;
+    }
+
+    token->id = 0;
+    if (parse_class[*p] & PARSE_QUOTE) {
+        p++;
+        token->type  = PARSECONF_TOKEN_QSTRING;
+        token->token = (const char*)p;
+
+        p = parse_scan(p, end, 1);
+        if (p == end || !(parse_class[*p] & PARSE_QUOTE)) {
+            return PARSECONF_ERROR;
+        }
+        token->length = p - (const unsigned char*)token->token;
+        p++;
+        /*
+         * Closing quote must be followed by a separator
+         */
+        if (p == end || !(parse_class[*p] & PARSE_SEPARATOR)) {
+            return PARSECONF_ERROR;
+        }
+    } else {
+        token->token = (const char*)p;
+
+        p = parse_scan(p, end, 0);
+        if (p == end || (parse_class[*p] & PARSE_EOL)) {
+            return PARSECONF_ERROR;
+        }
+        token->length = p - (const unsigned char*)token->token;
+        token->type   = parse_type((const unsigned char*)token->token, p);
+        if ((classify & SYNTAX_ADDRESS) && (token->type == PARSECONF_TOKEN_STRING || token->type == PARSECONF_TOKEN_END)) {
+            parse_address(token);
+        }
+        if ((classify & (SYNTAX_DURATION | SYNTAX_SIZE)) && token->type == PARSECONF_TOKEN_STRING) {
+            parse_unit(token, classify);
+        }
+        if (token->type == PARSECONF_TOKEN_END) {
+            return PARSECONF_ERROR;
+        }
+    }
+
+    for (; p < end && (parse_class[*p] & PARSE_SPACE); p++)
+        ;
+    if (p < end && (parse_class[*p] & PARSE_LAST)) {
+        p++;
+        ret = PARSECONF_LAST;
+    }
+
+    *conf = (const char*)p;
+    *length -= p - start;
+    return ret;
+}
+
+/*
+ * Check the tokens of a statement against the syntax, on success `syntax` is
+ * set to the matching syntax entry and `token` to the number of tokens
+ * checked. On failure `error` and `token` describe what failed and where.
+ */
+static int parse_check(const syntax_level_t* level, const parseconf_token_t* tokens, size_t token_size, const parseconf_syntax_t** syntax, parseconf_error_t* error, size_t* token)
+{
+    const syntax_keyword_t* keyword;
+    const syntax_state_t*   state;
+    size_t                  i, end;
+
+    if (!level || !tokens || !token_size) {
+        *error = PARSECONF_ERROR_INTERNAL;
+        *token = 0;
+        return PARSECONF_ERROR;
+    }
+
+    if (tokens[0].type != PARSECONF_TOKEN_STRING) {
+        *error = PARSECONF_ERROR_EXPECT_STRING;
+        *token = 0;
+        return PARSECONF_ERROR;
+    }
+
+    if (!(keyword = syntax_lookup(level, &tokens[0]))) {
+        *error = PARSECONF_ERROR_UNKNOWN;
+        *token = 0;
+        return PARSECONF_ERROR;
+    }
+    state = keyword->states;
+    end   = keyword->max < token_size ? keyword->max : token_size;
+
+    for (i = 1; i < end; i++) {
+        if (!(state->accept & SYNTAX_ACCEPT(tokens[i].type))) {
+            *error = state->error;
+            *token = i;
+            return PARSECONF_ERROR;
+        }
+
+        if (state->flags & SYNTAX_NESTED) {
+            if (!(keyword = syntax_lookup(keyword->nested, &tokens[i]))) {
+                *error = PARSECONF_ERROR_UNKNOWN;
+                *token = i;
+                return PARSECONF_ERROR;
+            }
+            state = keyword->states;
+            end   = keyword->max < token_size - i ? i + keyword->max : token_size;
+            continue;
+        }
+        if (!(state->flags & SYNTAX_REPEAT)) {
+            state++;
+        }
+    }
+
+    /*
+     * Only nested entries can be without a callback, when the statement
+     * ends before the nested keyword
+     */
+    if (!keyword->syntax->callback && !keyword->syntax->batch_callback) {
+        *error = PARSECONF_ERROR_NO_CALLBACK;
+        *token = i;
+        return PARSECONF_ERROR;
+    }
+
+    *syntax = keyword->syntax;
+    *token  = i;
+    return PARSECONF_OK;
+}
+
+/*
+ * Arena
+ *
+ * Bump allocator over blocks that are never moved, so pointers into it stay
+ * valid until it is reset or freed. Resetting keeps the last and largest
+ * block for reuse.
+ */
+
+typedef struct arena_block arena_block_t;
+struct arena_block {
+    arena_block_t* next;
+    size_t         size, used;
+    char           data[];
+};
+
+typedef struct arena arena_t;
+struct arena {
+    arena_block_t* blocks;
+};
+
+static void* arena_alloc(arena_t* arena, size_t size, size_t align)
+{
+    arena_block_t* block = arena->blocks;
+    size_t         used  = 0;
+
+    if (block) {
+        used = (block->used + align - 1) & ~(align - 1);
+    }
+    if (!block || used > block->size || size > block->size - used) {
+        size_t bsize = block ? block->size * 2 : 4096;
+
+        while (bsize < size) {
+            bsize *= 2;
+        }
+        if (!(block = malloc(sizeof(arena_block_t) + bsize))) {
+            return 0;
+        }
+        block->next   = arena->blocks;
+        block->size   = bsize;
+        arena->blocks = block;
+        used          = 0;
+    }
+    block->used = used + size;
+
+    return block->data + used;
+}
+
+static void arena_reset(arena_t* arena)
+{
+    arena_block_t *block, *next;
+
+    if (!arena->blocks) {
+        return;
+    }
+    for (block = arena->blocks->next; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    arena->blocks->next = 0;
+    arena->blocks->used = 0;
+}
+
+static void arena_free(arena_t* arena)
+{
+    arena_block_t *block, *next;
+
+    for (block = arena->blocks; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    arena->blocks = 0;
+}
+
+/*
+ * The arena given to the caller to keep tokens in, it is only freed by the
+ * caller
+ */
+
+struct parseconf_arena {
+    arena_t arena;
+};
+
+int parseconf_arena_new(parseconf_arena_t** arena)
+{
+    if (!arena) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!(*arena = calloc(1, sizeof(parseconf_arena_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+
+    return PARSECONF_OK;
+}
+
+void parseconf_arena_free(parseconf_arena_t* arena)
+{
+    if (arena) {
+        arena_free(&arena->arena);
+        free(arena);
+    }
+}
+
+/*
+ * Copy a token into the arena, the copy is NUL terminated
+ */
+const char* parseconf_arena_strdup(parseconf_arena_t* arena, const parseconf_token_t* token)
+{
+    char* p;
+
+    if (!arena || !token) {
+        return 0;
+    }
+
+    if (!(p = arena_alloc(&arena->arena, token->length + 1, 1))) {
+        return 0;
+    }
+    memcpy(p, token->token, token->length);
+    p[token->length] = 0;
+
+    return p;
+}
+
+/*
+ * Interning
+ *
+ * Equal STRING and QSTRING tokens are stored once in the arena, NUL
+ * terminated, and numbered from 1 in the order they are first seen. The
+ * table holds the ids of the entries, zero is an empty slot.
+ */
+
+typedef struct intern_entry intern_entry_t;
+struct intern_entry {
+    const char*  string;
+    size_t       length;
+    unsigned int hash;
+};
+
+struct parseconf_intern {
+    arena_t         arena;
+    intern_entry_t* entries;
+    size_t          size, alloc;
+    unsigned int*   table;
+    size_t          mask;
+};
+
+int parseconf_intern_new(parseconf_intern_t** intern)
+{
+    if (!intern) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!(*intern = calloc(1, sizeof(parseconf_intern_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+
+    return PARSECONF_OK;
+}
+
+void parseconf_intern_free(parseconf_intern_t* intern)
+{
+    if (intern) {
+        arena_free(&intern->arena);
+        free(intern->entries);
+        free(intern->table);
+        free(intern);
+    }
+}
+
+size_t parseconf_intern_size(const parseconf_intern_t* intern)
+{
+    return intern ? intern->size : 0;
+}
+
+const char* parseconf_intern_string(const parseconf_intern_t* intern, unsigned int id, size_t* length)
+{
+    if (!intern || !id || id > intern->size) {
+        return 0;
+    }
+
+    if (length) {
+        *length = intern->entries[id - 1].length;
+    }
+    return intern->entries[id - 1].string;
+}
+
+static int intern_grow(parseconf_intern_t* intern)
+{
+    size_t        size = intern->table ? (intern->mask + 1) * 2 : 1024, n, slot;
+    unsigned int* table;
+
+    if (!(table = calloc(size, sizeof(unsigned int)))) {
+        return PARSECONF_ENOMEM;
+    }
+    for (n = 0; n < intern->size; n++) {
+        for (slot = intern->entries[n].hash & (size - 1); table[slot]; slot = (slot + 1) & (size - 1))
+            ;
+        table[slot] = n + 1;
+    }
+    free(intern->table);
+    intern->table = table;
+    intern->mask  = size - 1;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Point the token to the interned copy of its bytes and set its id
+ */
+static int intern_token(parseconf_intern_t* intern, parseconf_token_t* token)
+{
+    const intern_entry_t* entry;
+    unsigned int          hash = syntax_hash(token->token, token->length);
+    size_t                slot;
+    char*                 p;
+
+    if ((!intern->table || intern->size * 2 >= intern->mask) && intern_grow(intern) != PARSECONF_OK) {
+        return PARSECONF_ENOMEM;
+    }
+
+    for (slot = hash & intern->mask; intern->table[slot]; slot = (slot + 1) & intern->mask) {
+        entry = &intern->entries[intern->table[slot] - 1];
+        if (entry->hash == hash && entry->length == token->length && !memcmp(entry->string, token->token, token->length)) {
+            token->token = entry->string;
+            token->id    = intern->table[slot];
+            return PARSECONF_OK;
+        }
+    }
+
+    if (intern->size == UINT_MAX) {
+        return PARSECONF_ENOMEM;
+    }
+    if (intern->size == intern->alloc) {
+        size_t          alloc = intern->alloc ? intern->alloc * 2 : 1024;
+        intern_entry_t* entries;
+
+        if (!(entries = realloc(intern->entries, alloc * sizeof(intern_entry_t)))) {
+            return PARSECONF_ENOMEM;
+        }
+        intern->entries = entries;
+        intern->alloc   = alloc;
+    }
+    if (!(p = arena_alloc(&intern->arena, token->length + 1, 1))) {
+        return PARSECONF_ENOMEM;
+    }
+    memcpy(p, token->token, token->length);
+    p[token->length] = 0;
+
+    intern->entries[intern->size].string = p;
+    intern->entries[intern->size].length = token->length;
+    intern->entries[intern->size].hash   = hash;
+    intern->size++;
+    intern->table[slot] = intern->size;
+
+    token->token = p;
+    token->id    = intern->size;
+    return PARSECONF_OK;
+}
+
+/*
+ * Statistics
+ *
+ * Only collected when requested, times are taken from the monotonic clock
+ * and are in nanoseconds.
+ */
+
+static inline uint64_t stats_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Add all syntax entries not already in the statistics and map the entries,
+ * numbered across all levels, to their keyword statistics
+ */
+static int stats_keywords(parseconf_stats_t* stats, const syntax_level_t* levels, size_t** map)
+{
+    const syntax_level_t*      level;
+    const parseconf_syntax_t*  syntaxp;
+    parseconf_stats_keyword_t* keywords;
+    size_t                     entries = 0, n, *index;
+
+    for (level = levels; level; level = level->next) {
+        entries += level->entries;
+    }
+    if (!entries) {
+        *map = 0;
+        return PARSECONF_OK;
+    }
+
+    if (!(index = malloc(entries * sizeof(size_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    if (!(keywords = realloc(stats->keywords, (stats->keywords_size + entries) * sizeof(parseconf_stats_keyword_t)))) {
+        free(index);
+        return PARSECONF_ENOMEM;
+    }
+    stats->keywords = keywords;
+
+    for (level = levels; level; level = level->next) {
+        for (syntaxp = level->syntax; syntaxp->token; syntaxp++) {
+            for (n = 0; n < stats->keywords_size && keywords[n].syntax != syntaxp; n++)
+                ;
+            if (n == stats->keywords_size) {
+                keywords[n].syntax = syntaxp;
+                keywords[n].calls  = 0;
+                keywords[n].time   = 0;
+                stats->keywords_size++;
+            }
+            index[level->index + (syntaxp - level->syntax)] = n;
+        }
+    }
+
+    *map = index;
+    return PARSECONF_OK;
+}
+
+void parseconf_stats_free(parseconf_stats_t* stats)
+{
+    if (stats) {
+        free(stats->keywords);
+        memset(stats, 0, sizeof(parseconf_stats_t));
+    }
+}
+
+/*
+ * Limits
+ *
+ * The limits of a call and how much has been used of them, shared with the
+ * parsers of included files. A limit of zero is no limit. The time is
+ * only checked every PARSECONF_LIMITS_LINES lines to keep it cheap.
+ */
+
+typedef struct parse_limits parse_limits_t;
+struct parse_limits {
+    parseconf_limits_t limits;
+    size_t             bytes, statements, lines;
+    uint64_t           deadline;
+};
+
+static void limits_init(parse_limits_t* limits, const parseconf_limits_t* from)
+{
+    memset(limits, 0, sizeof(parse_limits_t));
+    limits->limits = *from;
+    if (from->time) {
+        limits->deadline = stats_clock() + from->time;
+    }
+}
+
+/*
+ * Reset what has been used for another call
+ */
+static void limits_reset(parse_limits_t* limits)
+{
+    parseconf_limits_t from = limits->limits;
+
+    limits_init(limits, &from);
+}
+
+/*
+ * Parser state
+ *
+ * Statements are normally dispatched to their callbacks as soon as they have
+ * been checked. If a record is set they are instead checked and stored, with
+ * the first error, so that the callbacks can be called later in order.
+ */
+
+typedef struct parse_statement parse_statement_t;
+struct parse_statement {
+    const parseconf_syntax_t* syntax;
+    size_t                    tokens, token, line;
+};
+
+typedef struct parse_record parse_record_t;
+struct parse_record {
+    parseconf_token_t* tokens;
+    size_t             tokens_size, tokens_alloc;
+    parse_statement_t* statements;
+    size_t             statements_size, statements_alloc;
+
+    parseconf_error_t error;
+    size_t            error_tokens, error_token, error_line;
+};
+
+/*
+ * Errors are reported with `error_user`, which is `user` except when
+ * parsing a snapshot for a watch, see parseconf_watch_reload().
+ *
+ * Statements for a batch callback are collected in `batch`, if the input
+ * is not `stable`, and will be overwritten before the batch is called, the
+ * token bytes are copied into `arena`.
+ *
+ * The tokens of the statement being parsed are kept in `tokens` which grows
+ * as needed and is reused for every statement, so there is no limit on the
+ * number of tokens in a statement.
+ *
+ * If `retain` is set the tokens are copied into it before the callback is
+ * called, so they stay valid after parsing. If `intern` is set STRING and
+ * QSTRING tokens are interned when tokenized. If `include` is set include
+ * statements are handled by the parser, see Include below. If `limits` is
+ * set the input is checked against them, see Limits above. If `check` is
+ * set it replaces parse_check(), see parseconf_ctx_check(). If `expand` is
+ * set checked statements are recorded into it instead of being called, so
+ * included files can be expanded in place, see parseconf_file_reload().
+ */
+
+typedef struct include include_t;
+
+typedef struct parser parser_t;
+struct parser {
+    void*                      user;
+    const syntax_level_t*      levels;
+    parseconf_error_callback_t error_callback;
+    void*                      error_user;
+    size_t                     line;
+    parse_record_t*            record;
+    int                        stable;
+
+    parse_record_t         batch;
+    parseconf_statement_t* batch_statements;
+    size_t                 batch_alloc;
+    arena_t                arena;
+
+    parseconf_stats_t* stats;
+    size_t*            stats_map;
+
+    parseconf_token_t* tokens;
+    size_t             tokens_alloc;
+
+    parseconf_arena_t*  retain;
+    parseconf_intern_t* intern;
+    include_t*          include;
+    parse_limits_t*     limits;
+    parseconf_check_t   check;
+    unsigned int        classify;
+    size_t              applied;
+    parse_record_t*     expand;
+};
+
+static void record_free(parse_record_t* record)
+{
+    free(record->tokens);
+    free(record->statements);
+}
+
+static void parser_init(parser_t* parser, void* user, const syntax_level_t* levels, parseconf_error_callback_t error_callback)
+{
+    memset(parser, 0, sizeof(parser_t));
+    parser->user           = user;
+    parser->levels         = levels;
+    parser->error_callback = error_callback;
+    parser->error_user     = user;
+    parser->line           = 1;
+    parser->classify       = levels ? levels->classify : 0;
+}
+
+static void parser_free(parser_t* parser)
+{
+    record_free(&parser->batch);
+    free(parser->batch_statements);
+    arena_free(&parser->arena);
+    free(parser->stats_map);
+    free(parser->tokens);
+}
+
+/*
+ * Reset the parser for another call, everything allocated is kept for
+ * reuse
+ */
+static void parser_reset(parser_t* parser, void* user)
+{
+    parser->user                  = user;
+    parser->error_user            = user;
+    parser->line                  = 1;
+    parser->record                = 0;
+    parser->stable                = 0;
+    parser->batch.statements_size = 0;
+    parser->batch.tokens_size     = 0;
+    parser->include               = 0;
+    arena_reset(&parser->arena);
+}
+
+/*
+ * Tokens allocated at first, the vector grows as a statement needs
+ */
+#define PARSER_TOKENS 64
+
+/*
+ * Make room for at least one more token after `size` tokens, the tokens
+ * of the statement being parsed are kept
+ */
+static int parser_tokens(parser_t* parser, size_t size)
+{
+    size_t             alloc = parser->tokens_alloc ? parser->tokens_alloc : PARSER_TOKENS;
+    parseconf_token_t* p;
+
+    while (alloc < size + 2) {
+        alloc *= 2;
+    }
+    if (!(p = realloc(parser->tokens, alloc * sizeof(parseconf_token_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    parser->tokens       = p;
+    parser->tokens_alloc = alloc;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Copy the tokens into the retain arena, `tokens` is changed to the copied
+ * tokens which are kept in the token vector
+ */
+static int parse_retain(parser_t* parser, const parseconf_token_t** tokens)
+{
+    size_t size, n;
+
+    for (size = 0; (*tokens)[size].type != PARSECONF_TOKEN_END; size++)
+        ;
+    if (*tokens != parser->tokens) {
+        if (size + 1 >= parser->tokens_alloc && parser_tokens(parser, size) != PARSECONF_OK) {
+            return PARSECONF_ENOMEM;
+        }
+        memcpy(parser->tokens, *tokens, (size + 1) * sizeof(parseconf_token_t));
+        *tokens = parser->tokens;
+    }
+
+    for (n = 0; n < size; n++) {
+        const char* p;
+
+        if (parser->tokens[n].id) {
+            /*
+             * Interned tokens are already kept
+             */
+            continue;
+        }
+        if (!(p = parseconf_arena_strdup(parser->retain, &parser->tokens[n]))) {
+            return PARSECONF_ENOMEM;
+        }
+        parser->tokens[n].token = p;
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Collect statistics into `stats` while parsing, counters are added to and
+ * not reset so the same statistics can be used for many calls
+ */
+static int parser_stats(parser_t* parser, parseconf_stats_t* stats)
+{
+    int ret;
+
+    if (!stats) {
+        return PARSECONF_OK;
+    }
+    free(parser->stats_map);
+    parser->stats_map = 0;
+    if ((ret = stats_keywords(stats, parser->levels, &parser->stats_map)) != PARSECONF_OK) {
+        parser->stats = 0;
+        return ret;
+    }
+    parser->stats = stats;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Set the options of the calls, an option that is not set is turned off.
+ * The limits are copied into `limits` which is used while parsing.
+ */
+static int parser_options(parser_t* parser, const parseconf_options_t* options, parse_limits_t* limits)
+{
+    parser->retain = options ? options->arena : 0;
+    parser->intern = options ? options->intern : 0;
+    parser->limits = 0;
+    if (options && options->limits) {
+        limits_init(limits, options->limits);
+        parser->limits = limits;
+    }
+    if (!options || !options->stats) {
+        parser->stats = 0;
+        return PARSECONF_OK;
+    }
+
+    return parser_stats(parser, options->stats);
+}
+
+/*
+ * Add the time since `start` to the callback statistics
+ */
+static void stats_callback(parser_t* parser, const parseconf_syntax_t* syntax, uint64_t start)
+{
+    const syntax_level_t* level;
+    uint64_t              time = stats_clock() - start;
+
+    parser->stats->callback_time += time;
+    for (level = parser->levels; level; level = level->next) {
+        if (syntax >= level->syntax && syntax < level->syntax + level->entries) {
+            parseconf_stats_keyword_t* keyword = &parser->stats->keywords[parser->stats_map[level->index + (syntax - level->syntax)]];
+
+            keyword->calls++;
+            keyword->time += time;
+            return;
+        }
+    }
+}
+
+/*
+ * Add the statements, tokens and times of `add`, the lines and bytes are
+ * left to the caller
+ */
+static void stats_add(parseconf_stats_t* stats, const parseconf_stats_t* add)
+{
+    size_t n;
+
+    stats->statements += add->statements;
+    for (n = 0; n < PARSECONF_TOKEN_TYPES; n++) {
+        stats->tokens[n] += add->tokens[n];
+    }
+    if (add->line_peak > stats->line_peak) {
+        stats->line_peak = add->line_peak;
+    }
+    stats->tokenize_time += add->tokenize_time;
+    stats->check_time += add->check_time;
+}
+
+/*
+ * Store the tokens including the end token, returns the index of the first
+ * stored token or (size_t)-1 if out of memory
+ */
+static size_t record_tokens(parse_record_t* record, const parseconf_token_t* tokens, size_t size)
+{
+    size_t index = record->tokens_size;
+
+    size++;
+    if (record->tokens_size + size > record->tokens_alloc) {
+        size_t             alloc = record->tokens_alloc ? record->tokens_alloc : 1024;
+        parseconf_token_t* p;
+
+        while (alloc < record->tokens_size + size) {
+            alloc *= 2;
+        }
+        if (!(p = realloc(record->tokens, alloc * sizeof(parseconf_token_t)))) {
+            return (size_t)-1;
+        }
+        record->tokens       = p;
+        record->tokens_alloc = alloc;
+    }
+    memcpy(&record->tokens[index], tokens, (size - 1) * sizeof(parseconf_token_t));
+    record->tokens[index + size - 1].type = PARSECONF_TOKEN_END;
+    record->tokens_size += size;
+
+    return index;
+}
+
+static int record_statement(parse_record_t* record, const parseconf_syntax_t* syntax, const parseconf_token_t* tokens, size_t size, size_t token, size_t line)
+{
+    parse_statement_t* statement;
+
+    if (record->statements_size == record->statements_alloc) {
+        size_t             alloc = record->statements_alloc ? record->statements_alloc * 2 : 256;
+        parse_statement_t* p;
+
+        if (!(p = realloc(record->statements, alloc * sizeof(parse_statement_t)))) {
+            return PARSECONF_ENOMEM;
+        }
+        record->statements       = p;
+        record->statements_alloc = alloc;
+    }
+    statement = &record->statements[record->statements_size];
+    if ((statement->tokens = record_tokens(record, tokens, size)) == (size_t)-1) {
+        return PARSECONF_ENOMEM;
+    }
+    statement->syntax = syntax;
+    statement->token  = token;
+    statement->line   = line;
+    record->statements_size++;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Intern the strings of a record made without interning, the tokens of an
+ * error found while tokenizing would not have been interned
+ */
+static int record_intern(parseconf_intern_t* intern, parse_record_t* record)
+{
+    size_t n, size = record->tokens_size;
+
+    if (record->error == PARSECONF_ERROR_INVALID_SYNTAX && record->error_tokens != (size_t)-1) {
+        size = record->error_tokens;
+    }
+    for (n = 0; n < size; n++) {
+        if ((record->tokens[n].type == PARSECONF_TOKEN_STRING || record->tokens[n].type == PARSECONF_TOKEN_QSTRING) && intern_token(intern, &record->tokens[n]) != PARSECONF_OK) {
+            return PARSECONF_ENOMEM;
+        }
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Call the batch callback with the collected statements
+ */
+static int parse_flush(parser_t* parser)
+{
+    parse_record_t*           batch  = &parser->batch;
+    const parseconf_syntax_t* syntax;
+    const char*               errstr = "Syntax error or invalid arguments";
+    size_t                    n, failed = 0;
+    int                       ret       = PARSECONF_OK, err;
+    uint64_t                  start     = 0;
+
+    if (!batch->statements_size) {
+        return PARSECONF_OK;
+    }
+
+    if (batch->statements_size > parser->batch_alloc) {
+        parseconf_statement_t* p;
+
+        if (!(p = realloc(parser->batch_statements, batch->statements_alloc * sizeof(parseconf_statement_t)))) {
+            return PARSECONF_ENOMEM;
+        }
+        parser->batch_statements = p;
+        parser->batch_alloc      = batch->statements_alloc;
+    }
+    for (n = 0; n < batch->statements_size; n++) {
+        parser->batch_statements[n].tokens = &batch->tokens[batch->statements[n].tokens];
+        parser->batch_statements[n].line   = batch->statements[n].line;
+    }
+
+    syntax = batch->statements[0].syntax;
+    if (parser->stats) {
+        start = stats_clock();
+    }
+    err = syntax->batch_callback(parser->user, parser->batch_statements, batch->statements_size, &failed, &errstr);
+    if (parser->stats) {
+        stats_callback(parser, syntax, start);
+    }
+    if (err) {
+        if (failed >= batch->statements_size) {
+            failed = 0;
+        }
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_CALLBACK, batch->statements[failed].line, batch->statements[failed].token, parser->batch_statements[failed].tokens, errstr);
+        ret = PARSECONF_ERROR;
+        /*
+         * The statements before the failed one are applied
+         */
+        parser->applied += failed;
+    } else {
+        parser->applied += batch->statements_size;
+    }
+
+    batch->statements_size = 0;
+    batch->tokens_size     = 0;
+    arena_reset(&parser->arena);
+
+    return ret;
+}
+
+static int parse_batch(parser_t* parser, const parseconf_syntax_t* syntax, const parseconf_token_t* tokens, size_t token, size_t line)
+{
+    parse_record_t*    batch = &parser->batch;
+    parseconf_token_t* copy;
+    size_t             size;
+    int                ret;
+
+    if (batch->statements_size && batch->statements[0].syntax != syntax && (ret = parse_flush(parser)) != PARSECONF_OK) {
+        return ret;
+    }
+
+    for (size = 0; tokens[size].type != PARSECONF_TOKEN_END; size++)
+        ;
+    if ((ret = record_statement(batch, syntax, tokens, size, token, line)) != PARSECONF_OK) {
+        return ret;
+    }
+    if (!parser->stable && !parser->retain) {
+        for (copy = &batch->tokens[batch->statements[batch->statements_size - 1].tokens]; size; copy++, size--) {
+            char* p;
+
+            if (!copy->length || copy->id) {
+                continue;
+            }
+            if (!(p = arena_alloc(&parser->arena, copy->length, 1))) {
+                return PARSECONF_ENOMEM;
+            }
+            memcpy(p, copy->token, copy->length);
+            copy->token = p;
+        }
+    }
+
+    if (batch->statements_size >= (syntax->batch_size ? syntax->batch_size : PARSECONF_BATCH_SIZE)) {
+        return parse_flush(parser);
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Call the callback for a checked statement
+ */
+static int parse_call(parser_t* parser, const parseconf_syntax_t* syntax, const parseconf_token_t* tokens, size_t token, size_t line)
+{
+    const char* errstr = "Syntax error or invalid arguments";
+    int         ret;
+    uint64_t    start = 0;
+
+    if (parser->expand) {
+        size_t size;
+
+        for (size = 0; tokens[size].type != PARSECONF_TOKEN_END; size++)
+            ;
+        return record_statement(parser->expand, syntax, tokens, size, token, line);
+    }
+    if (parser->retain && (ret = parse_retain(parser, &tokens)) != PARSECONF_OK) {
+        return ret;
+    }
+    if (syntax->batch_callback) {
+        return parse_batch(parser, syntax, tokens, token, line);
+    }
+    if ((ret = parse_flush(parser)) != PARSECONF_OK) {
+        return ret;
+    }
+
+    if (parser->stats) {
+        start = stats_clock();
+    }
+    ret = syntax->callback(parser->user, tokens, &errstr);
+    if (parser->stats) {
+        stats_callback(parser, syntax, start);
+    }
+    if (ret) {
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_CALLBACK, line, token, tokens, errstr);
+        return PARSECONF_ERROR;
+    }
+    parser->applied++;
+
+    return PARSECONF_OK;
+}
+
+static const parseconf_token_type_t include_tokens[] = { PARSECONF_TOKEN_ANY, PARSECONF_TOKEN_END };
+static const parseconf_syntax_t     include_syntax   = { "include", 0, include_tokens, 0, 0, 0, 0 };
+
+static int include_statement(parser_t* parser, const parseconf_token_t* tokens, size_t line);
+
+/*
+ * Call the callbacks of all recorded statements in order, `line` is the line
+ * number of the first line of the recorded input. Recorded include
+ * statements are included, see Include below.
+ */
+static int record_dispatch(parser_t* parser, const parse_record_t* record, size_t line)
+{
+    const parse_statement_t* statement = record->statements;
+    size_t                   n;
+    int                      ret;
+
+    for (n = record->statements_size; n; n--, statement++) {
+        if (statement->syntax == &include_syntax) {
+            if ((ret = parse_flush(parser)) == PARSECONF_OK) {
+                ret = include_statement(parser, &record->tokens[statement->tokens], line + statement->line - 1);
+            }
+        } else {
+            ret = parse_call(parser, statement->syntax, &record->tokens[statement->tokens], statement->token, line + statement->line - 1);
+        }
+        if (ret != PARSECONF_OK) {
+            return ret;
+        }
+    }
+    if (record->error != PARSECONF_ERROR_NONE) {
+        if ((ret = parse_flush(parser)) != PARSECONF_OK) {
+            return ret;
+        }
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, record->error, line + record->error_line - 1, record->error_token, record->error_tokens == (size_t)-1 ? 0 : &record->tokens[record->error_tokens], 0);
+        return PARSECONF_ERROR;
+    }
+
+    return PARSECONF_OK;
+}
+
+static int parse_error(parser_t* parser, parseconf_error_t error, size_t token, const parseconf_token_t* tokens, size_t size)
+{
+    if (parser->record) {
+        parser->record->error        = error;
+        parser->record->error_token  = token;
+        parser->record->error_line   = parser->line;
+        parser->record->error_tokens = tokens ? record_tokens(parser->record, tokens, size) : (size_t)-1;
+    } else {
+        int ret;
+
+        if ((ret = parse_flush(parser)) != PARSECONF_OK) {
+            return ret;
+        }
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, error, parser->line, token, tokens, 0);
+    }
+
+    return PARSECONF_ERROR;
+}
+
+static int parse_statement(parser_t* parser, const parseconf_token_t* tokens, size_t size)
+{
+    const parseconf_syntax_t* syntax;
+    parseconf_error_t         error;
+    size_t                    token;
+    int                       ret;
+    uint64_t                  start = 0;
+
+    if (parser->stats) {
+        start = stats_clock();
+    }
+    if (parser->check) {
+        ret = parser->check(tokens, size, &syntax, &error, &token);
+    } else {
+        ret = parse_check(parser->levels, tokens, size, &syntax, &error, &token);
+    }
+    if (parser->stats) {
+        parser->stats->check_time += stats_clock() - start;
+        parser->stats->statements++;
+    }
+    if (parser->limits && parser->limits->limits.statements && ++parser->limits->statements > parser->limits->limits.statements) {
+        return parse_error(parser, PARSECONF_ERROR_TOO_MANY_STATEMENTS, 0, 0, 0);
+    }
+    if (ret != PARSECONF_OK) {
+        if (parser->include && error == PARSECONF_ERROR_UNKNOWN && !token && tokens[0].length == 7 && !memcmp(tokens[0].token, "include", 7)) {
+            /*
+             * Include statement and the syntax has no include of its own
+             */
+            if (size != 2) {
+                return parse_error(parser, size < 2 ? PARSECONF_ERROR_EXPECT_QSTRING : PARSECONF_ERROR_TOO_MANY_ARGUMENTS, size < 2 ? 1 : 2, tokens, size);
+            }
+            if (tokens[1].type != PARSECONF_TOKEN_QSTRING && tokens[1].type != PARSECONF_TOKEN_STRING) {
+                return parse_error(parser, PARSECONF_ERROR_EXPECT_QSTRING, 1, tokens, size);
+            }
+            if (parser->record) {
+                return record_statement(parser->record, &include_syntax, tokens, size, 2, parser->line);
+            }
+            if ((ret = parse_flush(parser)) != PARSECONF_OK) {
+                return ret;
+            }
+            return include_statement(parser, tokens, parser->line);
+        }
+        return parse_error(parser, error, token, error == PARSECONF_ERROR_INTERNAL ? 0 : tokens, size);
+    }
+    if (parser->record) {
+        return record_statement(parser->record, syntax, tokens, size, token, parser->line);
+    }
+
+    return parse_call(parser, syntax, tokens, token, parser->line);
+}
+
+/*
+ * Check the limits at the end of a line of `length` bytes
+ */
+static int parse_limits_line(parser_t* parser, size_t length)
+{
+    parse_limits_t* limits = parser->limits;
+
+    if (limits->limits.line_length && length > limits->limits.line_length) {
+        return parse_error(parser, PARSECONF_ERROR_LINE_TOO_LONG, 0, 0, 0);
+    }
+    if (limits->limits.time && !(++limits->lines % PARSECONF_LIMITS_LINES) && stats_clock() > limits->deadline) {
+        return parse_error(parser, PARSECONF_ERROR_TIMEOUT, 0, 0, 0);
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Check the limits after a token, or after failing to parse one if `token`
+ * is not set, `length` is the length of the line so far which is checked
+ * for every token so a long line does not grow the tokens
+ */
+static int parse_limits_token(parser_t* parser, const parseconf_token_t* token, size_t length)
+{
+    parse_limits_t* limits = parser->limits;
+
+    if (limits->limits.line_length && length > limits->limits.line_length) {
+        return parse_error(parser, PARSECONF_ERROR_LINE_TOO_LONG, 0, 0, 0);
+    }
+    if (token && limits->limits.token_length && token->length > limits->limits.token_length) {
+        return parse_error(parser, PARSECONF_ERROR_TOKEN_TOO_LONG, 0, 0, 0);
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Parse all statements in a buffer, it may contain any number of lines and
+ * does not need to be NUL terminated. `parser->line` is the line number of
+ * the first line in the buffer and is increased for every newline consumed.
+ */
+static int parse_buffer(parser_t* parser, const char* buf, size_t s)
+{
+    parseconf_token_t* tokens;
+    parseconf_stats_t* stats  = parser->stats;
+    parse_limits_t*    limits = parser->limits;
+    const char*        line   = buf;
+    size_t             i;
+    int                ret, err;
+    uint64_t           start = 0;
+
+    if (stats) {
+        stats->bytes += s;
+    }
+    if (limits && limits->limits.bytes && (limits->bytes += s) > limits->limits.bytes) {
+        return parse_error(parser, PARSECONF_ERROR_TOO_MANY_BYTES, 0, 0, 0);
+    }
+    while (s) {
+        /*
+         * Go to the first non white-space character
+         */
+        for (; s && (*buf == ' ' || *buf == '\t'); buf++, s--)
+            ;
+        if (!s) {
+            break;
+        }
+        if (*buf == '\n' || *buf == '\r' || !*buf) {
+            if (*buf == '\n') {
+                if (limits && (ret = parse_limits_line(parser, buf - line)) != PARSECONF_OK) {
+                    return ret;
+                }
+                parser->line++;
+                if (stats) {
+                    stats->lines++;
+                    if ((size_t)(buf - line) > stats->line_peak) {
+                        stats->line_peak = buf - line;
+                    }
+                }
+                line = buf + 1;
+            }
+            buf++;
+            s--;
+            continue;
+        }
+
+        /*
+         * Parse all the tokens
+         */
+        if (stats) {
+            start = stats_clock();
+        }
+        for (i = 0, ret = PARSECONF_OK; ret == PARSECONF_OK; i++) {
+            if (i + 1 >= parser->tokens_alloc && parser_tokens(parser, i) != PARSECONF_OK) {
+                return PARSECONF_ENOMEM;
+            }
+            ret = parse_token(&buf, &s, &parser->tokens[i], parser->classify);
+            if (limits && (err = parse_limits_token(parser, ret == PARSECONF_OK || ret == PARSECONF_LAST ? &parser->tokens[i] : 0, buf - line)) != PARSECONF_OK) {
+                return err;
+            }
+        }
+        tokens         = parser->tokens;
+        tokens[i].type = PARSECONF_TOKEN_END;
+
+        if (ret == PARSECONF_COMMENT) {
+            /*
+             * Line ended with comment, reduce the number of tokens and skip
+             * the rest of the line
+             */
+            i--;
+            tokens[i].type = PARSECONF_TOKEN_END;
+            for (; s && *buf != '\n' && *buf != '\r' && *buf; buf++, s--)
+                ;
+        } else if (ret != PARSECONF_LAST) {
+            /*
+             * The token that failed is not complete, report the tokens
+             * before it
+             */
+            i--;
+            tokens[i].type = PARSECONF_TOKEN_END;
+            return parse_error(parser, PARSECONF_ERROR_INVALID_SYNTAX, 0, tokens, i);
+        }
+        if (parser->intern) {
+            size_t n;
+
+            for (n = 0; n < i; n++) {
+                if ((tokens[n].type == PARSECONF_TOKEN_STRING || tokens[n].type == PARSECONF_TOKEN_QSTRING) && intern_token(parser->intern, &tokens[n]) != PARSECONF_OK) {
+                    return PARSECONF_ENOMEM;
+                }
+            }
+        }
+        if (stats) {
+            size_t n;
+
+            stats->tokenize_time += stats_clock() - start;
+            for (n = 0; n < i; n++) {
+                stats->tokens[tokens[n].type]++;
+            }
+        }
+
+        /*
+         * Config using the tokens
+         */
+        if (i && (ret = parse_statement(parser, tokens, i)) != PARSECONF_OK) {
+            return ret;
+        }
+    }
+    if (stats && buf > line) {
+        /*
+         * Last line without a newline
+         */
+        stats->lines++;
+        if ((size_t)(buf - line) > stats->line_peak) {
+            stats->line_peak = buf - line;
+        }
+    }
+    if (limits && buf > line && limits->limits.line_length && (size_t)(buf - line) > limits->limits.line_length) {
+        return parse_error(parser, PARSECONF_ERROR_LINE_TOO_LONG, 0, 0, 0);
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Include
+ *
+ * parseconf_file() handles `include "file";` statements itself unless the
+ * syntax has an include keyword. A relative file is relative to the
+ * directory of the including file and if it contains any of `*?[` it is a
+ * pattern that may match any number of files, which are included sorted.
+ *
+ * Included files are read whole and recorded, the records are kept by
+ * device, inode and modification time until the end of the call so a file
+ * that is included many times is only parsed once. Files that are being
+ * included are marked active, and the device and inode of the top file is
+ * kept, to detect cycles. All files matched by a pattern are advised to the
+ * kernel as needed before the first one is parsed, so the rest are read in
+ * the background.
+ *
+ * Errors in included files have the line number within that file and the
+ * path of the file as error string.
+ *
+ * If `watch` is set all included files, and the directories of patterns,
+ * are added to it, see Watch below.
+ */
+
+typedef struct include_file include_file_t;
+struct include_file {
+    include_file_t* next;
+    dev_t           dev;
+    ino_t           ino;
+    time_t          mtime;
+    off_t           size;
+    int             active;
+
+    void*          map;
+    char*          buf;
+    parse_record_t record;
+};
+
+struct include {
+    include_file_t*    files;
+    const char*        file;
+    parseconf_watch_t* watch;
+
+    int   top;
+    dev_t dev;
+    ino_t ino;
+};
+
+static void watch_add(parseconf_watch_t* watch, const char* path, int any);
+static void* watch_arg(parseconf_watch_t* watch);
+
+static void include_free(include_t* include)
+{
+    include_file_t* next;
+
+    for (; include->files; include->files = next) {
+        next = include->files->next;
+        if (include->files->map) {
+            munmap(include->files->map, include->files->size);
+        }
+        free(include->files->buf);
+        record_free(&include->files->record);
+        free(include->files);
+    }
+}
+
+/*
+ * Find or add the file, `new` is set if it was added
+ */
+static include_file_t* include_find(include_t* include, const struct stat* st, int* new)
+{
+    include_file_t* file;
+
+    for (file = include->files; file; file = file->next) {
+        if (file->dev == st->st_dev && file->ino == st->st_ino && file->mtime == st->st_mtime && file->size == st->st_size) {
+            *new = 0;
+            return file;
+        }
+    }
+    if (!(file = calloc(1, sizeof(include_file_t)))) {
+        return 0;
+    }
+    file->dev      = st->st_dev;
+    file->ino      = st->st_ino;
+    file->mtime    = st->st_mtime;
+    file->size     = st->st_size;
+    file->next     = include->files;
+    include->files = file;
+    *new           = 1;
+
+    return file;
+}
+
+/*
+ * Read and record the file, errors in the file are recorded and reported
+ * when it is dispatched
+ */
+static int include_load(parser_t* parser, include_file_t* file, int fd)
+{
+    parser_t    sub;
+    const char* data;
+    size_t      size = 0;
+    ssize_t     n;
+    int         ret;
+
+    if (file->size > 0 && (unsigned long long)file->size <= (size_t)-1
+        && (file->map = mmap(0, file->size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+        data = file->map;
+        size = file->size;
+    } else {
+        size_t alloc = 4096;
+
+        file->map = 0;
+        if (!(file->buf = malloc(alloc))) {
+            return PARSECONF_ENOMEM;
+        }
+        while ((n = read(fd, file->buf + size, alloc - size)) > 0) {
+            size += n;
+            if (size == alloc) {
+                char* p;
+
+                if (!(p = realloc(file->buf, alloc * 2))) {
+                    return PARSECONF_ENOMEM;
+                }
+                file->buf = p;
+                alloc *= 2;
+            }
+        }
+        if (n < 0) {
+            return PARSECONF_ERROR;
+        }
+        data = file->buf;
+    }
+
+    parser_init(&sub, parser->user, parser->levels, parser->error_callback);
+    sub.error_user = parser->error_user;
+    sub.record     = &file->record;
+    sub.intern     = parser->intern;
+    sub.include    = parser->include;
+    sub.limits     = parser->limits;
+    sub.check      = parser->check;
+    sub.stats      = parser->stats;
+    sub.stats_map  = parser->stats_map;
+    ret            = parse_buffer(&sub, data, size);
+    sub.stats_map  = 0;
+    parser_free(&sub);
+
+    return ret == PARSECONF_OK || file->record.error != PARSECONF_ERROR_NONE ? PARSECONF_OK : ret;
+}
+
+/*
+ * Dispatch the record of an included file, `path` is used for relative
+ * includes in the file and for errors
+ */
+static int include_dispatch(parser_t* parser, const parse_record_t* record, const char* path)
+{
+    include_t*               include = parser->include;
+    const parse_statement_t* statement;
+    const char*              parent  = include->file;
+    size_t                   n;
+    int                      ret = PARSECONF_OK;
+
+    include->file = path;
+    for (n = record->statements_size, statement = record->statements; n; n--, statement++) {
+        if (statement->syntax == &include_syntax) {
+            ret = include_statement(parser, &record->tokens[statement->tokens], statement->line);
+        } else {
+            ret = parse_call(parser, statement->syntax, &record->tokens[statement->tokens], statement->token, statement->line);
+        }
+        if (ret != PARSECONF_OK) {
+            break;
+        }
+    }
+    if (ret == PARSECONF_OK && record->error != PARSECONF_ERROR_NONE && (ret = parse_flush(parser)) == PARSECONF_OK) {
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, record->error, record->error_line, record->error_token, record->error_tokens == (size_t)-1 ? 0 : &record->tokens[record->error_tokens], path);
+        ret = PARSECONF_ERROR;
+    }
+    include->file = parent;
+
+    return ret;
+}
+
+static int include_file(parser_t* parser, const char* path, size_t line)
+{
+    include_file_t* file;
+    struct stat     st;
+    int             fd, new, ret = PARSECONF_OK;
+
+    if (parser->include->watch) {
+        watch_add(parser->include->watch, path, 0);
+    }
+    if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st)) {
+        if (fd >= 0)
+            close(fd);
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_FILE_ERRNO, line, 1, 0, path);
+        return PARSECONF_ERROR;
+    }
+    if (parser->include->top && st.st_dev == parser->include->dev && st.st_ino == parser->include->ino) {
+        close(fd);
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_INCLUDE_CYCLE, line, 1, 0, path);
+        return PARSECONF_ERROR;
+    }
+    if (!(file = include_find(parser->include, &st, &new))) {
+        close(fd);
+        return PARSECONF_ENOMEM;
+    }
+    if (file->active) {
+        close(fd);
+        if (parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_INCLUDE_CYCLE, line, 1, 0, path);
+        return PARSECONF_ERROR;
+    }
+    if (new && (ret = include_load(parser, file, fd)) != PARSECONF_OK) {
+        close(fd);
+        if (ret == PARSECONF_ERROR && parser->error_callback)
+            parser->error_callback(parser->error_user, PARSECONF_ERROR_FILE_ERRNO, line, 1, 0, path);
+        return ret;
+    }
+    close(fd);
+
+    file->active = 1;
+    ret          = include_dispatch(parser, &file->record, path);
+    file->active = 0;
+
+    return ret;
+}
+
+static int include_statement(parser_t* parser, const parseconf_token_t* tokens, size_t line)
+{
+    const char* parent = parser->include->file;
+    const char* slash  = parent ? strrchr(parent, '/') : 0;
+    size_t      dir    = tokens[1].token[0] != '/' && slash ? slash - parent + 1 : 0, n;
+    char*       path;
+    glob_t      g;
+    int         ret;
+
+    if (!(path = malloc(dir + tokens[1].length + 1))) {
+        return PARSECONF_ENOMEM;
+    }
+    if (dir) {
+        memcpy(path, parent, dir);
+    }
+    memcpy(path + dir, tokens[1].token, tokens[1].length);
+    path[dir + tokens[1].length] = 0;
+
+    if (!strpbrk(path + dir, "*?[")) {
+        ret = include_file(parser, path, line);
+        free(path);
+        return ret;
+    }
+
+    if (parser->include->watch) {
+        watch_add(parser->include->watch, path, 1);
+    }
+    ret = glob(path, 0, 0, &g);
+    free(path);
+    if (ret) {
+        return ret == GLOB_NOMATCH ? PARSECONF_OK : PARSECONF_ENOMEM;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    for (n = 1; n < g.gl_pathc; n++) {
+        int fd;
+
+        if ((fd = open(g.gl_pathv[n], O_RDONLY)) >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+    }
+#endif
+    for (n = 0, ret = PARSECONF_OK; ret == PARSECONF_OK && n < g.gl_pathc; n++) {
+        ret = include_file(parser, g.gl_pathv[n], line);
+    }
+    globfree(&g);
+
+    return ret;
+}
+
+#if PARSECONF_ENABLE_THREADS
+/*
+ * Parallel parsing
+ *
+ * The input is split into chunks at newlines, which are always safe since
+ * statements can not span lines, of at most PARSECONF_CHUNK_SIZE bytes.
+ * The chunks are tokenized and checked into records by a pool of threads,
+ * each taking the next chunk not yet taken, while the calling thread
+ * dispatches the records in order as they are done, like parseconf_dir()
+ * does with files. Only two chunks per thread are taken ahead of the one
+ * being dispatched so the records do not grow with the input.
+ *
+ * Include statements are only recorded by the chunks, the files are read
+ * and included by the calling thread when the statement is dispatched.
+ * Strings are interned by the calling thread as well, in order, so they
+ * get the same ids as when parsed by one thread.
+ *
+ * Each chunk has statistics of its own that are added as it is
+ * dispatched, the tokenize and check times are then the sum of all threads
+ * and after an error they include the rest of the chunk. The line and
+ * token length limits and the time limit are checked by each chunk. The
+ * bytes are counted for the whole input at once like parse_buffer() does,
+ * but a limit on the number of statements can only be checked in order so
+ * such input is parsed by the calling thread alone. parseconf_file_options()
+ * reads a file with either limit line by line, as without threads.
+ */
+
+typedef struct parse_chunk parse_chunk_t;
+struct parse_chunk {
+    const char*       buf;
+    size_t            size, lines;
+    parse_record_t    record;
+    parseconf_stats_t stats;
+    int               ret, done;
+};
+
+typedef struct parse_pool parse_pool_t;
+struct parse_pool {
+    const parser_t* parser;
+    parse_limits_t  limits;
+    parse_chunk_t*  chunks;
+    size_t          size, next, dispatched, window;
+    int             stop;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+/*
+ * Tokenize and check the chunk into its record, errors are recorded and
+ * reported when it is dispatched
+ */
+static int parse_chunk_load(const parse_pool_t* pool, parse_chunk_t* chunk)
+{
+    parser_t       sub;
+    parse_limits_t limits = pool->limits;
+    int            ret;
+
+    parser_init(&sub, pool->parser->user, pool->parser->levels, pool->parser->error_callback);
+    sub.error_user = pool->parser->error_user;
+    sub.record     = &chunk->record;
+    sub.include    = pool->parser->include;
+    if (pool->parser->stats) {
+        sub.stats = &chunk->stats;
+    }
+    if (pool->parser->limits) {
+        sub.limits = &limits;
+    }
+    ret          = parse_buffer(&sub, chunk->buf, chunk->size);
+    chunk->lines = sub.line - 1;
+    parser_free(&sub);
+
+    return ret == PARSECONF_OK || chunk->record.error != PARSECONF_ERROR_NONE ? PARSECONF_OK : ret;
+}
+
+static void* parse_pool_thread(void* arg)
+{
+    parse_pool_t* pool = (parse_pool_t*)arg;
+    size_t        n;
+    int           ret;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop && pool->next < pool->size) {
+        if (pool->next >= pool->dispatched + pool->window) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        n = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        ret = parse_chunk_load(pool, &pool->chunks[n]);
+        pthread_mutex_lock(&pool->lock);
+        pool->chunks[n].ret  = ret;
+        pool->chunks[n].done = 1;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+/*
+ * Wait for the chunk to be done or load it if no thread has taken it
+ */
+static void parse_pool_wait(parse_pool_t* pool, size_t n)
+{
+    int ret;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->chunks[n].done && pool->next == n) {
+        pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        ret = parse_chunk_load(pool, &pool->chunks[n]);
+        pthread_mutex_lock(&pool->lock);
+        pool->chunks[n].ret  = ret;
+        pool->chunks[n].done = 1;
+    }
+    while (!pool->chunks[n].done) {
+        pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static int parse_parallel(parser_t* parser, const char* buf, size_t size, size_t threads)
+{
+    parse_pool_t   pool;
+    parse_chunk_t* chunk;
+    const char *   p, *end = buf + size;
+    size_t         n, chunk_size = size / threads;
+    pthread_t*     thread  = 0;
+    size_t         started = 0;
+    int            ret;
+
+    if (parser->limits && parser->limits->limits.statements) {
+        /*
+         * Statements must be counted in order, see above
+         */
+        return parse_buffer(parser, buf, size);
+    }
+    if (parser->stats) {
+        parser->stats->bytes += size;
+    }
+    if (parser->limits && parser->limits->limits.bytes && (parser->limits->bytes += size) > parser->limits->limits.bytes) {
+        return parse_error(parser, PARSECONF_ERROR_TOO_MANY_BYTES, 0, 0, 0);
+    }
+    if (chunk_size > PARSECONF_CHUNK_SIZE) {
+        chunk_size = PARSECONF_CHUNK_SIZE;
+    }
+    if (!chunk_size) {
+        chunk_size = 1;
+    }
+
+    memset(&pool, 0, sizeof(pool));
+    if (!(pool.chunks = calloc(size / chunk_size + 1, sizeof(parse_chunk_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    for (p = buf; p < end; pool.size++) {
+        const char* next = (size_t)(end - p) > chunk_size ? p + chunk_size : end;
+
+        for (; next < end && next[-1] != '\n'; next++)
+            ;
+        pool.chunks[pool.size].buf  = p;
+        pool.chunks[pool.size].size = next - p;
+        p                           = next;
+    }
+    pool.parser = parser;
+    if (parser->limits) {
+        /*
+         * The bytes have been counted above, like parse_buffer() does for
+         * the whole input
+         */
+        pool.limits              = *parser->limits;
+        pool.limits.limits.bytes = 0;
+    }
+    pool.window = threads * 2;
+
+    /*
+     * The calling thread loads chunks too so one thread less is started
+     */
+    if (threads > pool.size) {
+        threads = pool.size;
+    }
+    pthread_mutex_init(&pool.lock, 0);
+    pthread_cond_init(&pool.cond, 0);
+    if (threads > 1 && (thread = calloc(threads - 1, sizeof(pthread_t)))) {
+        for (; started < threads - 1; started++) {
+            if (pthread_create(&thread[started], 0, parse_pool_thread, &pool)) {
+                break;
+            }
+        }
+    }
+
+    for (n = 0, ret = PARSECONF_OK; ret == PARSECONF_OK && n < pool.size; n++) {
+        chunk = &pool.chunks[n];
+        parse_pool_wait(&pool, n);
+        if (parser->stats) {
+            parser->stats->lines += chunk->stats.lines;
+            stats_add(parser->stats, &chunk->stats);
+        }
+        if (chunk->ret != PARSECONF_OK) {
+            ret = chunk->ret;
+        } else if (!parser->intern || (ret = record_intern(parser->intern, &chunk->record)) == PARSECONF_OK) {
+            ret = record_dispatch(parser, &chunk->record, parser->line);
+        }
+        parser->line += chunk->lines;
+        record_free(&chunk->record);
+        memset(&chunk->record, 0, sizeof(chunk->record));
+
+        pthread_mutex_lock(&pool.lock);
+        pool.dispatched = n + 1;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+    for (n = 0; n < started; n++) {
+        pthread_join(thread[n], 0);
+    }
+    free(thread);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    for (n = 0; n < pool.size; n++) {
+        record_free(&pool.chunks[n].record);
+    }
+    free(pool.chunks);
+
+    return ret;
+}
+#endif
+
+/*
+ * Value helpers
+ *
+ * Numbers are converted directly from the token without copying it, the
+ * integer conversions only accept decimal digits and check for overflow.
+ * Floating point values with at most 19 significant digits and a small
+ * exponent are converted exactly with one multiplication or division, others
+ * fall back to strtod()/strtold() with the decimal point of the locale of
+ * the calling thread substituted for the dot.
+ *
+ * On little endian targets runs of 8 digits are checked and converted 8 at
+ * a time in a 64 bit word (SWAR), a value of at most 19 digits can not
+ * overflow 64 bits so it is converted without checking each digit.
+ */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PARSE_SWAR 1
+
+static inline uint64_t parse_load8(const char* p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Non-zero if all 8 bytes are digits, adding 6 moves ':' and above out of
+ * the 0x30 high nibble
+ */
+static inline int parse_digits8(uint64_t v)
+{
+    return !(((v & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL));
+}
+
+/*
+ * Convert 8 digits, the first digit is the lowest byte, by combining pairs
+ * of digits, then pairs of those and last the two halves
+ */
+static inline uint32_t parse_value8(uint64_t v)
+{
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL) + (((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+
+    return (uint32_t)v;
+}
+#endif
+
+/*
+ * Convert up to 19 digits, returns non-zero if any is not a digit
+ */
+static inline int parse_digits(const char* p, size_t n, uint64_t* value)
+{
+    uint64_t v = 0;
+
+#ifdef PARSE_SWAR
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w = parse_load8(p);
+
+        if (!parse_digits8(w)) {
+            return 1;
+        }
+        v = v * 100000000ULL + parse_value8(w);
+    }
+#endif
+    for (; n; p++, n--) {
+        unsigned int d = (unsigned char)*p - '0';
+
+        if (d > 9) {
+            return 1;
+        }
+        v = v * 10 + d;
+    }
+
+    *value = v;
+    return 0;
+}
+
+static int parse_unsigned(const parseconf_token_t* token, unsigned long long int max, unsigned long long int* value, const char** errstr)
+{
+    const char*            p;
+    size_t                 n;
+    unsigned long long int v = 0;
+
+    if (!token || !value) {
+        return 1;
+    }
+    if (!token->token || !token->length) {
+        if (errstr)
+            *errstr = "Invalid value";
+        return 1;
+    }
+
+    if (token->length <= 19) {
+        uint64_t w;
+
+        if (parse_digits(token->token, token->length, &w)) {
+            if (errstr)
+                *errstr = "Invalid value";
+            return 1;
+        }
+        if (w > max) {
+            if (errstr)
+                *errstr = "Too large value";
+            return 1;
+        }
+
+        *value = w;
+        return 0;
+    }
+
+    for (p = token->token, n = token->length; n; p++, n--) {
+        unsigned int d = (unsigned char)*p - '0';
+
+        if (d > 9) {
+            if (errstr)
+                *errstr = "Invalid value";
+            return 1;
+        }
+        if (v > (max - d) / 10) {
+            if (errstr)
+                *errstr = "Too large value";
+            return 1;
+        }
+        v = v * 10 + d;
+    }
+
+    *value = v;
+    return 0;
+}
+
+static int parse_signed(const parseconf_token_t* token, long long int min, long long int max, long long int* value, const char** errstr)
+{
+    parseconf_token_t      digits;
+    unsigned long long int v;
+    int                    negative = 0;
+
+    if (!token || !value) {
+        return 1;
+    }
+
+    digits = *token;
+    if (digits.token && digits.length && (*digits.token == '-' || *digits.token == '+')) {
+        negative = *digits.token == '-';
+        digits.token++;
+        digits.length--;
+    }
+    if (parse_unsigned(&digits, negative ? (unsigned long long int)-(min + 1) + 1 : (unsigned long long int)max, &v, errstr)) {
+        return 1;
+    }
+
+    *value = negative ? (v ? -(long long int)(v - 1) - 1 : 0) : (long long int)v;
+    return 0;
+}
+
+int parseconf_ulongint(const parseconf_token_t* token, unsigned long int* value, const char** errstr)
+{
+    unsigned long long int v;
+
+    if (!value || parse_unsigned(token, ULONG_MAX, &v, errstr)) {
+        return 1;
+    }
+
+    *value = v;
+    return 0;
+}
+
+int parseconf_ulonglongint(const parseconf_token_t* token, unsigned long long int* value, const char** errstr)
+{
+    return parse_unsigned(token, ULLONG_MAX, value, errstr);
+}
+
+int parseconf_int64(const parseconf_token_t* token, int64_t* value, const char** errstr)
+{
+    long long int v;
+
+    if (!value || parse_signed(token, INT64_MIN, INT64_MAX, &v, errstr)) {
+        return 1;
+    }
+
+    *value = v;
+    return 0;
+}
+
+int parseconf_uint64(const parseconf_token_t* token, uint64_t* value, const char** errstr)
+{
+    unsigned long long int v;
+
+    if (!value || parse_unsigned(token, UINT64_MAX, &v, errstr)) {
+        return 1;
+    }
+
+    *value = v;
+    return 0;
+}
+
+int parseconf_uint32(const parseconf_token_t* token, uint32_t* value, const char** errstr)
+{
+    unsigned long long int v;
+
+    if (!value || parse_unsigned(token, UINT32_MAX, &v, errstr)) {
+        return 1;
+    }
+
+    *value = v;
+    return 0;
+}
+
+int parseconf_uint16(const parseconf_token_t* token, uint16_t* value, const char** errstr)
+{
+    unsigned long long int v;
+
+    if (!value || parse_unsigned(token, UINT16_MAX, &v, errstr)) {
+        return 1;
+    }
+
+    *value = v;
+    return 0;
+}
+
+/*
+ * Split a decimal floating point token into sign, mantissa and exponent,
+ * returns non-zero if the token can not be converted exactly by
+ * parse_float()
+ */
+static int parse_decimal(const parseconf_token_t* token, int* negative, uint64_t* mantissa, int* exponent)
+{
+    const char* p   = token->token;
+    const char* end = token->token + token->length;
+    uint64_t    w   = 0;
+    int         e = 0, digits = 0, dot = 0, any = 0;
+
+    *negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        *negative = *p == '-';
+        p++;
+    }
+    for (; p < end; p++) {
+        if (*p == '.' && !dot) {
+            dot = 1;
+            continue;
+        }
+        if (*p < '0' || *p > '9') {
+            break;
+        }
+        any = 1;
+        if (!w && *p == '0') {
+            if (dot) {
+                e--;
+            }
+            continue;
+        }
+#ifdef PARSE_SWAR
+        if (w && digits <= 11 && end - p >= 8 && parse_digits8(parse_load8(p))) {
+            w = w * 100000000ULL + parse_value8(parse_load8(p));
+            digits += 8;
+            if (dot) {
+                e -= 8;
+            }
+            p += 7;
+            continue;
+        }
+#endif
+        if (digits == 19) {
+            return 1;
+        }
+        w = w * 10 + (*p - '0');
+        digits++;
+        if (dot) {
+            e--;
+        }
+    }
+    if (!any) {
+        return 1;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int exp = 0, eneg = 0;
+
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) {
+            eneg = *p == '-';
+            p++;
+        }
+        if (p == end) {
+            return 1;
+        }
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (exp > 1000) {
+                return 1;
+            }
+            exp = exp * 10 + (*p - '0');
+        }
+        e += eneg ? -exp : exp;
+    }
+    if (p != end) {
+        return 1;
+    }
+
+    *mantissa = w;
+    *exponent = e;
+    return 0;
+}
+
+static const double parse_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Copy the decimal point of the locale of the calling thread, which is the
+ * one strtod() uses, into `point`. localeconv() returns a structure that
+ * other threads may overwrite so nl_langinfo_l() is used where available,
+ * it does not take the global locale so that is duplicated for it.
+ */
+static void parse_point(char* point, size_t size)
+{
+    const char* p;
+#if defined(LC_GLOBAL_LOCALE) && defined(RADIXCHAR)
+    locale_t locale = uselocale(0), copy = 0;
+
+    if (locale == LC_GLOBAL_LOCALE) {
+        locale = copy = duplocale(LC_GLOBAL_LOCALE);
+    }
+    p = locale ? nl_langinfo_l(RADIXCHAR, locale) : 0;
+#else
+    p = localeconv()->decimal_point;
+#endif
+    if (!p || !*p || strlen(p) >= size) {
+        p = ".";
+    }
+    memcpy(point, p, strlen(p) + 1);
+#if defined(LC_GLOBAL_LOCALE) && defined(RADIXCHAR)
+    if (copy) {
+        freelocale(copy);
+    }
+#endif
+}
+
+/*
+ * Copy the token into `buf` with the locale's decimal point for strtod()
+ */
+static int parse_locale(const parseconf_token_t* token, char* buf, size_t size, const char** errstr)
+{
+    char   point[8];
+    size_t plen, i, n;
+
+    parse_point(point, sizeof(point));
+    plen = strlen(point);
+    for (i = 0, n = 0; i < token->length; i++) {
+        if (token->token[i] == '.') {
+            if (n + plen >= size) {
+                break;
+            }
+            memcpy(buf + n, point, plen);
+            n += plen;
+            continue;
+        }
+        if (n + 1 >= size) {
+            break;
+        }
+        buf[n++] = token->token[i];
+    }
+    if (i < token->length) {
+        if (errstr)
+            *errstr = "Too large value";
+        return 1;
+    }
+    buf[n] = 0;
+
+    return 0;
+}
+
+int parseconf_double(const parseconf_token_t* token, double* value, const char** errstr)
+{
+    char     buf[64];
+    char*    endptr = 0;
+    uint64_t w;
+    int      e, negative;
+
+    if (!token) {
+        return 1;
+    }
+    if (!value) {
+        return 1;
+    }
+    if (!token->token || !token->length) {
+        if (errstr)
+            *errstr = "Invalid value";
+        return 1;
+    }
+
+#if FLT_EVAL_METHOD == 0
+    if (!parse_decimal(token, &negative, &w, &e) && w <= (1ULL << 53) && e >= -22 && e <= 22) {
+        double d = (double)w;
+
+        d      = e < 0 ? d / parse_pow10[-e] : d * parse_pow10[e];
+        *value = negative ? -d : d;
+        return 0;
+    }
+#endif
+
+    if (parse_locale(token, buf, sizeof(buf), errstr)) {
+        return 1;
+    }
+    *value = strtod(buf, &endptr);
+
+    if (!endptr || *endptr) {
+        if (errstr)
+            *errstr = "Invalid value";
+        return 1;
+    }
+
+    return 0;
+}
+
+int parseconf_longdouble(const parseconf_token_t* token, long double* value, const char** errstr)
+{
+    char     buf[128];
+    char*    endptr = 0;
+    uint64_t w;
+    int      e, negative;
+
+    if (!token) {
+        return 1;
+    }
+    if (!value) {
+        return 1;
+    }
+    if (!token->token || !token->length) {
+        if (errstr)
+            *errstr = "Invalid value";
+        return 1;
+    }
+
+    if (!parse_decimal(token, &negative, &w, &e) && w <= (1ULL << 53) && e >= -22 && e <= 22) {
+        long double d = (long double)w;
+
+        d      = e < 0 ? d / (long double)parse_pow10[-e] : d * (long double)parse_pow10[e];
+        *value = negative ? -d : d;
+        return 0;
+    }
+
+    if (parse_locale(token, buf, sizeof(buf), errstr)) {
+        return 1;
+    }
+    *value = strtold(buf, &endptr);
+
+    if (!endptr || *endptr) {
+        if (errstr)
+            *errstr = "Invalid value";
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Convert `count` tokens starting at `start` into `values`, on failure
+ * `failed` is set to the index in `tokens` of the first token that failed
+ */
+int parseconf_numbers_u64(const parseconf_token_t* tokens, size_t start, uint64_t* values, size_t count, size_t* failed, const char** errstr)
+{
+    unsigned long long int v;
+    size_t                 n;
+
+    if (!tokens || !values) {
+        return 1;
+    }
+
+    for (tokens += start, n = 0; n < count; n++) {
+        if (tokens[n].type == PARSECONF_TOKEN_END) {
+            if (errstr)
+                *errstr = "Missing value";
+            break;
+        }
+        if (parse_unsigned(&tokens[n], UINT64_MAX, &v, errstr)) {
+            break;
+        }
+        values[n] = v;
+    }
+    if (n < count) {
+        if (failed)
+            *failed = start + n;
+        return 1;
+    }
+
+    return 0;
+}
+
+int parseconf_numbers_double(const parseconf_token_t* tokens, size_t start, double* values, size_t count, size_t* failed, const char** errstr)
+{
+    size_t n;
+
+    if (!tokens || !values) {
+        return 1;
+    }
+
+    for (tokens += start, n = 0; n < count; n++) {
+        if (tokens[n].type == PARSECONF_TOKEN_END) {
+            if (errstr)
+                *errstr = "Missing value";
+            break;
+        }
+        if (parseconf_double(&tokens[n], &values[n], errstr)) {
+            break;
+        }
+    }
+    if (n < count) {
+        if (failed)
+            *failed = start + n;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Calls
+ */
+
+/*
+ * Like getline() but reads at most `max` bytes of a line, so a line longer
+ * than the limit is not read into memory and parse_buffer() will find that
+ * it is too long
+ */
+static ssize_t parse_getline(char** buffer, size_t* bufsize, FILE* fp, size_t max)
+{
+    size_t size = 0;
+    int    c;
+
+    while (size < max) {
+        if (size + 1 >= *bufsize) {
+            size_t alloc = *bufsize ? *bufsize * 2 : 128;
+            char*  p;
+
+            if (alloc > max + 1) {
+                alloc = max + 1;
+            }
+            if (!(p = realloc(*buffer, alloc))) {
+                return -1;
+            }
+            *buffer  = p;
+            *bufsize = alloc;
+        }
+        if ((c = getc_unlocked(fp)) == EOF) {
+            break;
+        }
+        (*buffer)[size++] = c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    if (!size) {
+        return -1;
+    }
+    (*buffer)[size] = 0;
+
+    return size;
+}
+
+static int parse_file(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options, parseconf_watch_t* watch)
+{
+    FILE*              fp;
+    char*              buffer  = 0;
+    size_t             bufsize = 0;
+    ssize_t            ret;
+    syntax_level_t*    levels;
+    parser_t           parser;
+    parseconf_stats_t* stats = options ? options->stats : 0;
+    uint64_t           start = 0;
+    include_t          include;
+    struct stat        st;
+    parse_limits_t     limits;
+    size_t             max = 0;
+    int                err;
+    void*              error_user;
+
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    /*
+     * A watch parses into the snapshot given as `user`, errors are
+     * reported with the argument of the watch instead
+     */
+    error_user = watch ? watch_arg(watch) : user;
+
+    if (watch) {
+        /*
+         * Watch the file even if it can not be opened, so it is parsed when
+         * it is created
+         */
+        watch_add(watch, file, 0);
+    }
     if (!(fp = fopen(file, "r"))) {
+        if (error_callback)
+            error_callback(error_user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        return PARSECONF_ERROR;
+    }
+    if ((err = syntax_compile(syntax, &levels)) != PARSECONF_OK) {
+        fclose(fp);
+        return err;
+    }
+    parser_init(&parser, user, levels, error_callback);
+    parser.error_user = error_user;
+    if (parser_options(&parser, options, &limits) != PARSECONF_OK) {
+        parser_free(&parser);
+        syntax_free(levels);
+        fclose(fp);
+        return PARSECONF_ENOMEM;
+    }
+    if (parser.limits && limits.limits.line_length) {
+        /*
+         * The line and its newline, one byte more is a line too long
+         */
+        max = limits.limits.line_length + 1;
+    }
+
+    memset(&include, 0, sizeof(include));
+    include.file   = file;
+    parser.include = &include;
+    include.watch  = watch;
+    if (!fstat(fileno(fp), &st)) {
+        include.top = 1;
+        include.dev = st.st_dev;
+        include.ino = st.st_ino;
+    }
+
+    while (1) {
+        size_t current = parser.line;
+
+        if (stats) {
+            start = stats_clock();
+        }
+        ret = max ? parse_getline(&buffer, &bufsize, fp, max) : getline(&buffer, &bufsize, fp);
+        if (stats) {
+            stats->read_time += stats_clock() - start;
+            if (bufsize > stats->buffer_peak) {
+                stats->buffer_peak = bufsize;
+            }
+        }
+        if (ret <= 0) {
+            break;
+        }
+
+        if (max && (size_t)ret == max && buffer[ret - 1] != '\n') {
+            /*
+             * The line was cut at the limit
+             */
+            err = parse_error(&parser, PARSECONF_ERROR_LINE_TOO_LONG, 0, 0, 0);
+        } else {
+            err = parse_buffer(&parser, buffer, ret);
+        }
+        if (err != PARSECONF_OK) {
+            include_free(&include);
+            parser_free(&parser);
+            syntax_free(levels);
+            free(buffer);
+            fclose(fp);
+            return PARSECONF_ERROR;
+        }
+        /*
+         * Last line without a newline still counts as a line
+         */
+        if (parser.line == current) {
+            parser.line++;
+        }
+    }
+    if (parse_flush(&parser) != PARSECONF_OK) {
+        include_free(&include);
+        parser_free(&parser);
+        syntax_free(levels);
+        free(buffer);
+        fclose(fp);
+        return PARSECONF_ERROR;
+    }
+    if (ret < 0) {
+        long pos;
+
+        pos = ftell(fp);
+        if (fseek(fp, 0, SEEK_END)) {
+            if (error_callback)
+                error_callback(error_user, PARSECONF_ERROR_FILE_ERRNO, parser.line, 0, 0, 0);
+        } else if (ftell(fp) < pos) {
+            if (error_callback)
+                error_callback(error_user, PARSECONF_ERROR_FILE_ERRNO, parser.line, 0, 0, 0);
+        }
+    }
+    include_free(&include);
+    parser_free(&parser);
+    syntax_free(levels);
+    free(buffer);
+    fclose(fp);
+
+    return PARSECONF_OK;
+}
+
+int parseconf_file(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    return parse_file(user, file, syntax, error_callback, 0, 0);
+}
+
+static int parse_file_mapped(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads, const parseconf_options_t* options)
+{
+    int             fd, ret;
+    struct stat     st;
+    void*           map;
+    syntax_level_t* levels;
+    parser_t        parser;
+    include_t       include;
+    parse_limits_t  limits;
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+        if (error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        return PARSECONF_ERROR;
+    }
+    if (fstat(fd, &st)) {
+        if (error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        close(fd);
+        return PARSECONF_ERROR;
+    }
+    if (!S_ISREG(st.st_mode) || (unsigned long long)st.st_size > (size_t)-1) {
+        /*
+         * Pipes, devices and such can not be mapped so use the stream
+         */
+        close(fd);
+        return parse_file(user, file, syntax, error_callback, options, 0);
+    }
+    if (!st.st_size) {
+        close(fd);
+        return PARSECONF_OK;
+    }
+    if ((map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return parse_file(user, file, syntax, error_callback, options, 0);
+    }
+    close(fd);
+#ifdef MADV_SEQUENTIAL
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    if ((ret = syntax_compile(syntax, &levels)) == PARSECONF_OK) {
+        parser_init(&parser, user, levels, error_callback);
+        parser.stable = 1;
+        memset(&include, 0, sizeof(include));
+        include.file   = file;
+        include.top    = 1;
+        include.dev    = st.st_dev;
+        include.ino    = st.st_ino;
+        parser.include = &include;
+
+        if ((ret = parser_options(&parser, options, &limits)) == PARSECONF_OK) {
+#if PARSECONF_ENABLE_THREADS
+            if (threads > 1)
+                ret = parse_parallel(&parser, map, st.st_size, threads);
+            else
+#else
+            (void)threads;
+#endif
+                ret = parse_buffer(&parser, map, st.st_size);
+        }
+        if (ret == PARSECONF_OK) {
+            ret = parse_flush(&parser);
+        }
+        include_free(&include);
+        parser_free(&parser);
+        syntax_free(levels);
+    }
+    munmap(map, st.st_size);
+
+    return ret;
+}
+
+int parseconf_file_mmap(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_file_mapped(user, file, syntax, error_callback, 1, 0);
+}
+
+int parseconf_file_parallel(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads)
+{
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 0 ? cpus : 1;
+    }
+
+    return parse_file_mapped(user, file, syntax, error_callback, threads, 0);
+}
+
+int parseconf_file_options(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options)
+{
+    if (!options) {
+        return PARSECONF_EINVAL;
+    }
+    if (options->threads > 1 && !(options->limits && (options->limits->bytes || options->limits->statements))) {
+        /*
+         * Bytes and statements are counted line by line in order when a
+         * file is read, see Parallel parsing
+         */
+        if (!file) {
+            return PARSECONF_EINVAL;
+        }
+        if (!syntax) {
+            return PARSECONF_EINVAL;
+        }
+        return parse_file_mapped(user, file, syntax, error_callback, options->threads, options);
+    }
+
+    return parse_file(user, file, syntax, error_callback, options, 0);
+}
+
+/*
+ * Parse the text with a parser that is set up and freed by the caller, the
+ * text may have any number of lines and ends at `length` or the first NUL.
+ * It is parsed by parse_buffer() like files so line numbers, statistics and
+ * limits are the same, or by parse_parallel() if `threads` is more than one.
+ */
+static int parse_text(parser_t* parser, const char* text, const size_t length, size_t threads)
+{
+    const char* nul;
+    size_t      size = (nul = memchr(text, 0, length)) ? (size_t)(nul - text) : length;
+    int         ret;
+
+    parser->stable = 1;
+#if PARSECONF_ENABLE_THREADS
+    if (threads > 1)
+        ret = parse_parallel(parser, text, size, threads);
+    else
+#else
+    (void)threads;
+#endif
+        ret = parse_buffer(parser, text, size);
+    if (ret != PARSECONF_OK) {
+        return ret;
+    }
+
+    return parse_flush(parser);
+}
+
+static int parse_text_options(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options)
+{
+    syntax_level_t* levels;
+    parser_t        parser;
+    parse_limits_t  limits;
+    int             ret;
+
+    if (!text) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+    if ((ret = syntax_compile(syntax, &levels)) != PARSECONF_OK) {
+        return ret;
+    }
+
+    parser_init(&parser, user, levels, error_callback);
+    if ((ret = parser_options(&parser, options, &limits)) == PARSECONF_OK) {
+        ret = parse_text(&parser, text, length, options ? options->threads : 0);
+    }
+    parser_free(&parser);
+    syntax_free(levels);
+
+    return ret;
+}
+
+int parseconf_text(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    return parse_text_options(user, text, length, syntax, error_callback, 0);
+}
+
+int parseconf_text_options(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options)
+{
+    if (!options) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_text_options(user, text, length, syntax, error_callback, options);
+}
+
+/*
+ * Context
+ *
+ * A context keeps the compiled syntax, the parser with its token vector and
+ * batch storage, and a read buffer between calls so parsing many configs
+ * with the same syntax does not allocate once the buffers have grown to fit
+ * the largest config. Files are read whole into the read buffer, which is
+ * stable during the call so batched statements are not copied.
+ *
+ * A context has no state shared with other contexts, so each thread can
+ * use its own context but a context can only be used by one thread at a
+ * time.
+ */
+
+struct parseconf_ctx {
+    syntax_level_t* levels;
+    parser_t        parser;
+    char*           buffer;
+    size_t          alloc;
+    parse_limits_t  limits;
+};
+
+int parseconf_ctx_new(parseconf_ctx_t** ctx, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    parseconf_ctx_t* c;
+    int              ret;
+
+    if (!ctx) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!(c = calloc(1, sizeof(parseconf_ctx_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    if ((ret = syntax_compile(syntax, &c->levels)) != PARSECONF_OK) {
+        free(c);
+        return ret;
+    }
+    parser_init(&c->parser, 0, c->levels, error_callback);
+
+    *ctx = c;
+    return PARSECONF_OK;
+}
+
+void parseconf_ctx_free(parseconf_ctx_t* ctx)
+{
+    if (ctx) {
+        parser_free(&ctx->parser);
+        syntax_free(ctx->levels);
+        free(ctx->buffer);
+        free(ctx);
+    }
+}
+
+/*
+ * Set the options used by the following calls, replacing those set
+ * before. The limits, and the time, apply to each call on its own.
+ */
+int parseconf_ctx_options(parseconf_ctx_t* ctx, const parseconf_options_t* options)
+{
+    if (!ctx) {
+        return PARSECONF_EINVAL;
+    }
+    if (!options) {
+        return PARSECONF_EINVAL;
+    }
+    if (options->threads > 1) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parser_options(&ctx->parser, options, &ctx->limits);
+}
+
+/*
+ * Use `check` to check statements instead of the compiled syntax, such as
+ * the check function generated by parsegen. It must return syntax entries
+ * from the syntax the context was created with, those are used for the
+ * callbacks and statistics.
+ */
+int parseconf_ctx_check(parseconf_ctx_t* ctx, parseconf_check_t check)
+{
+    if (!ctx) {
+        return PARSECONF_EINVAL;
+    }
+    if (!check) {
+        return PARSECONF_EINVAL;
+    }
+
+    ctx->parser.check = check;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Read the file into the read buffer, `hint` is the expected size and at
+ * most `max` bytes are read
+ */
+static int ctx_read(parseconf_ctx_t* ctx, int fd, size_t hint, size_t max, size_t* size)
+{
+    size_t  alloc = ctx->alloc ? ctx->alloc : 4096;
+    ssize_t n = 0;
+    char*   p;
+
+    /*
+     * One byte more than expected so the end is found without growing
+     */
+    while (alloc <= hint) {
+        alloc *= 2;
+    }
+    if (alloc != ctx->alloc) {
+        if (!(p = realloc(ctx->buffer, alloc))) {
+            return PARSECONF_ENOMEM;
+        }
+        ctx->buffer = p;
+        ctx->alloc  = alloc;
+    }
+
+    *size = 0;
+    while (*size < max && (n = read(fd, ctx->buffer + *size, ctx->alloc - *size)) > 0) {
+        *size += n;
+        if (*size == ctx->alloc && *size < max) {
+            if (!(p = realloc(ctx->buffer, ctx->alloc * 2))) {
+                return PARSECONF_ENOMEM;
+            }
+            ctx->buffer = p;
+            ctx->alloc *= 2;
+        }
+    }
+    if (n < 0) {
+        return PARSECONF_ERROR;
+    }
+
+    return PARSECONF_OK;
+}
+
+int parseconf_ctx_file(parseconf_ctx_t* ctx, void* user, const char* file)
+{
+    parser_t*   parser;
+    include_t   include;
+    struct stat st;
+    size_t      size, max = (size_t)-1;
+    uint64_t    start = 0;
+    int         fd, ret;
+
+    if (!ctx) {
+        return PARSECONF_EINVAL;
+    }
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    parser = &ctx->parser;
+
+    if ((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st)) {
+        if (fd >= 0)
+            close(fd);
+        if (parser->error_callback)
+            parser->error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        return PARSECONF_ERROR;
+    }
+    if (parser->limits) {
+        limits_reset(parser->limits);
+        if (parser->limits->limits.bytes) {
+            /*
+             * One byte more than the limit is enough to find it is exceeded
+             */
+            max = parser->limits->limits.bytes + 1;
+        }
+    }
+    if (parser->stats) {
+        start = stats_clock();
+    }
+    ret = ctx_read(ctx, fd, S_ISREG(st.st_mode) && (unsigned long long)st.st_size < max ? st.st_size : 0, max, &size);
+    if (parser->stats) {
+        parser->stats->read_time += stats_clock() - start;
+        if (ctx->alloc > parser->stats->buffer_peak) {
+            parser->stats->buffer_peak = ctx->alloc;
+        }
+    }
+    if (ret != PARSECONF_OK) {
+        if (ret == PARSECONF_ERROR && parser->error_callback)
+            parser->error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        close(fd);
+        return ret;
+    }
+    close(fd);
+
+    parser_reset(parser, user);
+    parser->stable = 1;
+    memset(&include, 0, sizeof(include));
+    include.file    = file;
+    include.top     = 1;
+    include.dev     = st.st_dev;
+    include.ino     = st.st_ino;
+    parser->include = &include;
+
+    if ((ret = parse_buffer(parser, ctx->buffer, size)) == PARSECONF_OK) {
+        ret = parse_flush(parser);
+    }
+    parser->include = 0;
+    include_free(&include);
+
+    return ret;
+}
+
+int parseconf_ctx_text(parseconf_ctx_t* ctx, void* user, const char* text, const size_t length)
+{
+    if (!ctx) {
+        return PARSECONF_EINVAL;
+    }
+    if (!text) {
+        return PARSECONF_EINVAL;
+    }
+
+    parser_reset(&ctx->parser, user);
+    if (ctx->parser.limits) {
+        limits_reset(ctx->parser.limits);
+    }
+
+    return parse_text(&ctx->parser, text, length, 0);
+}
+
+/*
+ * Cache
+ *
+ * The statements of a successfully checked file can be stored in a cache
+ * file as indexes into the syntax and offsets into the file, the cache is
+ * only used if the file size, content hash and the fingerprint of the
+ * syntax are the same as when it was written.
+ *
+ * parseconf_file_cached_stat() trusts the modification time and inode
+ * instead, the content is only hashed, and compared, if either changed.
+ * A file rewritten in place with its old modification time, as touch -r
+ * or cp -p do, then replays the statements of the old content. Either way
+ * a cache that is still good but has another modification time or inode
+ * is written again with the new ones. A file modified in the same second
+ * as its cache is written could be modified again without changing its
+ * modification time, such a cache is written without it so it is hashed
+ * when used.
+ *
+ * Include statements are stored with level CACHE_INCLUDE, only the
+ * including file is cached, included files are read each time.
+ */
+
+#define CACHE_MAGIC 0x70636663
+#define CACHE_VERSION 3
+#define CACHE_INCLUDE 0xffffffff
+
+typedef struct cache_header cache_header_t;
+struct cache_header {
+    uint32_t magic, version;
+    uint64_t size, mtime, ino, hash, fingerprint, statements, tokens;
+};
+
+typedef struct cache_statement cache_statement_t;
+struct cache_statement {
+    uint32_t level, entry;
+    uint64_t tokens, token, line;
+};
+
+typedef struct cache_token cache_token_t;
+struct cache_token {
+    uint32_t type, reserved;
+    uint64_t offset, length;
+};
+
+static inline uint64_t cache_hash(uint64_t hash, const void* data, size_t length)
+{
+    const unsigned char* p = (const unsigned char*)data;
+
+    for (; length; p++, length--) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t cache_fingerprint(const syntax_level_t* levels)
+{
+    const syntax_level_t*         level;
+    const syntax_level_t*         nested;
+    const parseconf_syntax_t*     syntaxp;
+    const parseconf_token_type_t* type;
+    uint64_t                      hash = 14695981039346656037ULL, index;
+
+    for (level = levels; level; level = level->next) {
+        for (syntaxp = level->syntax; syntaxp->token; syntaxp++) {
+            hash = cache_hash(hash, syntaxp->token, strlen(syntaxp->token) + 1);
+            hash = cache_hash(hash, syntaxp->callback || syntaxp->batch_callback ? "c" : "-", 1);
+            for (type = syntaxp->syntax; type && *type != PARSECONF_TOKEN_END; type++) {
+                hash = cache_hash(hash, type, sizeof(*type));
+            }
+            index = 0;
+            if (syntaxp->nested) {
+                for (nested = levels, index = 1; nested && nested->syntax != syntaxp->nested; nested = nested->next) {
+                    index++;
+                }
+            }
+            hash = cache_hash(hash, &index, sizeof(index));
+        }
+        hash = cache_hash(hash, "", 1);
+    }
+
+    return hash;
+}
+
+static int cache_index(const syntax_level_t* levels, const parseconf_syntax_t* syntax, uint32_t* level, uint32_t* entry)
+{
+    uint32_t n;
+
+    if (syntax == &include_syntax) {
+        *level = CACHE_INCLUDE;
+        *entry = 0;
+        return PARSECONF_OK;
+    }
+    for (n = 0; levels; levels = levels->next, n++) {
+        if (syntax >= levels->syntax && syntax < levels->syntax + levels->entries) {
+            *level = n;
+            *entry = syntax - levels->syntax;
+            return PARSECONF_OK;
+        }
+    }
+
+    return PARSECONF_ERROR;
+}
+
+/*
+ * Non-zero if `type` is a type the tokenizer gives
+ */
+static int cache_type(uint32_t type)
+{
+    switch (type) {
+    case PARSECONF_TOKEN_END:
+    case PARSECONF_TOKEN_STRING:
+    case PARSECONF_TOKEN_QSTRING:
+    case PARSECONF_TOKEN_NUMBER:
+    case PARSECONF_TOKEN_FLOAT:
+    case PARSECONF_TOKEN_IPADDR:
+    case PARSECONF_TOKEN_PREFIX:
+    case PARSECONF_TOKEN_DURATION:
+    case PARSECONF_TOKEN_SIZE:
+        return 1;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Load the cache into a record, the tokens will point into `map`. If
+ * `hashed` is set the hash in `expect` is compared, otherwise the content
+ * of `map` is only hashed if the modification time or inode differ and
+ * then the hash is set in `expect` and `hashed` is set. `moved` is set if
+ * they differ.
+ */
+static int cache_load(const char* cache, const syntax_level_t* levels, cache_header_t* expect, const char* map, parse_record_t* record, int* hashed, int* moved)
+{
+    int                      fd, ret = PARSECONF_ERROR;
+    struct stat              st;
+    void*                    data;
+    const cache_header_t*    header;
+    const cache_statement_t* statement;
+    const cache_token_t*     token;
+    const syntax_level_t*    level;
+    size_t                   n;
+    uint32_t                 l;
+
+    if ((fd = open(cache, O_RDONLY)) < 0) {
+        return PARSECONF_ERROR;
+    }
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(cache_header_t)
+        || (data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return PARSECONF_ERROR;
+    }
+    close(fd);
+
+    header = (const cache_header_t*)data;
+    if (header->magic != CACHE_MAGIC
+        || header->version != CACHE_VERSION
+        || header->size != expect->size
+        || header->fingerprint != expect->fingerprint
+        || header->statements > ((size_t)st.st_size - sizeof(cache_header_t)) / sizeof(cache_statement_t)
+        || header->tokens != ((size_t)st.st_size - sizeof(cache_header_t) - header->statements * sizeof(cache_statement_t)) / sizeof(cache_token_t)) {
+        munmap(data, st.st_size);
+        return PARSECONF_ERROR;
+    }
+    if (header->mtime != expect->mtime || header->ino != expect->ino) {
+        /*
+         * Touched, replaced or copied, the cache is still good if the
+         * content is the same
+         */
+        *moved = 1;
+        if (!*hashed) {
+            expect->hash = cache_hash(14695981039346656037ULL, map, expect->size);
+            *hashed      = 1;
+        }
+    }
+    if (*hashed && header->hash != expect->hash) {
+        munmap(data, st.st_size);
+        return PARSECONF_ERROR;
+    }
+
+    if ((header->statements && !(record->statements = malloc(header->statements * sizeof(parse_statement_t))))
+        || (header->tokens && !(record->tokens = malloc(header->tokens * sizeof(parseconf_token_t))))) {
+        munmap(data, st.st_size);
+        return PARSECONF_ENOMEM;
+    }
+    record->statements_alloc = header->statements;
+    record->tokens_alloc     = header->tokens;
+
+    statement = (const cache_statement_t*)(header + 1);
+    for (n = header->statements; n; n--, statement++) {
+        if (statement->level == CACHE_INCLUDE) {
+            if (statement->entry || statement->tokens >= header->tokens) {
+                break;
+            }
+            record->statements[record->statements_size].syntax = &include_syntax;
+        } else {
+            for (level = levels, l = statement->level; level && l; level = level->next, l--)
+                ;
+            if (!level || statement->entry >= level->entries || statement->tokens >= header->tokens) {
+                break;
+            }
+            record->statements[record->statements_size].syntax = &level->syntax[statement->entry];
+        }
+        record->statements[record->statements_size].tokens = statement->tokens;
+        record->statements[record->statements_size].token  = statement->token;
+        record->statements[record->statements_size].line   = statement->line;
+        record->statements_size++;
+    }
+    token = (const cache_token_t*)statement;
+    for (n = header->tokens; n && !(record->statements_size < header->statements); n--, token++) {
+        if (token->offset > header->size || token->length > header->size - token->offset || !cache_type(token->type)) {
+            break;
+        }
+        record->tokens[record->tokens_size].type   = (parseconf_token_type_t)token->type;
+        record->tokens[record->tokens_size].token  = map + token->offset;
+        record->tokens[record->tokens_size].length = token->length;
+        record->tokens[record->tokens_size].id     = 0;
+        if (token->type == PARSECONF_TOKEN_IPADDR || token->type == PARSECONF_TOKEN_PREFIX
+            || token->type == PARSECONF_TOKEN_DURATION || token->type == PARSECONF_TOKEN_SIZE) {
+            /*
+             * Addresses and values are not stored in binary, parse them
+             * again
+             */
+            if (!token->length) {
+                break;
+            }
+            record->tokens[record->tokens_size].type = PARSECONF_TOKEN_STRING;
+            if (token->type == PARSECONF_TOKEN_IPADDR || token->type == PARSECONF_TOKEN_PREFIX) {
+                parse_address(&record->tokens[record->tokens_size]);
+            } else {
+                parse_unit(&record->tokens[record->tokens_size], token->type == PARSECONF_TOKEN_DURATION ? SYNTAX_DURATION : SYNTAX_SIZE);
+            }
+            if (record->tokens[record->tokens_size].type != token->type) {
+                break;
+            }
+        }
+        record->tokens_size++;
+    }
+
+    ret = record->statements_size == header->statements && record->tokens_size == header->tokens ? PARSECONF_OK : PARSECONF_ERROR;
+    munmap(data, st.st_size);
+
+    /*
+     * The tokens of each statement must end within the record, with the
+     * error token at most at the end
+     */
+    for (n = 0; ret == PARSECONF_OK && n < record->statements_size; n++) {
+        const parse_statement_t* recorded = &record->statements[n];
+        size_t                   size;
+
+        for (size = 0; recorded->tokens + size < record->tokens_size && record->tokens[recorded->tokens + size].type != PARSECONF_TOKEN_END; size++)
+            ;
+        if (recorded->tokens + size == record->tokens_size || !size || recorded->token > size) {
+            ret = PARSECONF_ERROR;
+        }
+    }
+
+    return ret;
+}
+
+static void cache_save(const char* cache, const syntax_level_t* levels, const cache_header_t* header, const char* map, const parse_record_t* record)
+{
+    FILE*             fp;
+    char*             tmp;
+    cache_statement_t statement;
+    cache_token_t     token;
+    size_t            n;
+    int               fd, err = 0;
+
+    /*
+     * Write to a unique file next to the cache and rename it in place, so
+     * concurrent writers never share a file and readers never see a
+     * partial cache
+     */
+    if (!(tmp = malloc(strlen(cache) + 8))) {
+        return;
+    }
+    sprintf(tmp, "%s.XXXXXX", cache);
+    if ((fd = mkstemp(tmp)) < 0) {
+        free(tmp);
+        return;
+    }
+    if (!(fp = fdopen(fd, "w"))) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return;
+    }
+
+    if (fwrite(header, sizeof(*header), 1, fp) != 1) {
+        err = 1;
+    }
+    for (n = 0; !err && n < record->statements_size; n++) {
+        memset(&statement, 0, sizeof(statement));
+        if (cache_index(levels, record->statements[n].syntax, &statement.level, &statement.entry) != PARSECONF_OK) {
+            err = 1;
+            break;
+        }
+        statement.tokens = record->statements[n].tokens;
+        statement.token  = record->statements[n].token;
+        statement.line   = record->statements[n].line;
+        if (fwrite(&statement, sizeof(statement), 1, fp) != 1) {
+            err = 1;
+        }
+    }
+    for (n = 0; !err && n < record->tokens_size; n++) {
+        memset(&token, 0, sizeof(token));
+        token.type = record->tokens[n].type;
+        if (token.type != PARSECONF_TOKEN_END) {
+            token.offset = record->tokens[n].token - map;
+            token.length = record->tokens[n].length;
+        }
+        if (fwrite(&token, sizeof(token), 1, fp) != 1) {
+            err = 1;
+        }
+    }
+
+    if (fclose(fp) || err || rename(tmp, cache)) {
+        unlink(tmp);
+    }
+    free(tmp);
+}
+
+/*
+ * Parse the file using the cache, if `trust_stat` is set the content is
+ * only hashed if the modification time or inode changed
+ */
+static int parse_file_cached(void* user, const char* file, const char* cache, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, int trust_stat)
+{
+    int             fd, ret;
+    struct stat     st;
+    void*           map;
+    syntax_level_t* levels;
+    parser_t        parser;
+    parse_record_t  record;
+    cache_header_t  header;
+    include_t       include;
+    int             hashed = 0, moved = 0;
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+        if (error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        return PARSECONF_ERROR;
+    }
+    if (fstat(fd, &st)) {
+        if (error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        close(fd);
+        return PARSECONF_ERROR;
+    }
+    if (!S_ISREG(st.st_mode) || !st.st_size || (unsigned long long)st.st_size > (size_t)-1) {
+        /*
+         * Nothing to cache for empty or special files
+         */
+        close(fd);
+        return parseconf_file(user, file, syntax, error_callback);
+    }
+    if ((map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return parseconf_file(user, file, syntax, error_callback);
+    }
+    close(fd);
+#ifdef MADV_SEQUENTIAL
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    if ((ret = syntax_compile(syntax, &levels)) != PARSECONF_OK) {
+        munmap(map, st.st_size);
+        return ret;
+    }
+    parser_init(&parser, user, levels, error_callback);
+    parser.stable = 1;
+    memset(&include, 0, sizeof(include));
+    include.file   = file;
+    include.top    = 1;
+    include.dev    = st.st_dev;
+    include.ino    = st.st_ino;
+    parser.include = &include;
+
+    memset(&header, 0, sizeof(header));
+    header.magic       = CACHE_MAGIC;
+    header.version     = CACHE_VERSION;
+    header.size        = st.st_size;
+    header.mtime       = st.st_mtime;
+    header.ino         = st.st_ino;
+    header.fingerprint = cache_fingerprint(levels);
+    if (!trust_stat) {
+        header.hash = cache_hash(14695981039346656037ULL, map, st.st_size);
+        hashed      = 1;
+    }
+
+    memset(&record, 0, sizeof(record));
+    ret = cache_load(cache, levels, &header, map, &record, &hashed, &moved);
+    if (st.st_mtime >= time(0)) {
+        /*
+         * Modified in this second, save the cache without the modification
+         * time so the content is hashed when it is used
+         */
+        header.mtime = 0;
+    }
+    if (ret != PARSECONF_OK) {
+        /*
+         * No valid cache, parse the file and save it if there were no
+         * errors
+         */
+        record_free(&record);
+        memset(&record, 0, sizeof(record));
+        parser.record = &record;
+        ret           = parse_buffer(&parser, map, st.st_size);
+        parser.record = 0;
+        if (ret == PARSECONF_OK) {
+            if (!hashed) {
+                header.hash = cache_hash(14695981039346656037ULL, map, st.st_size);
+            }
+            header.statements = record.statements_size;
+            header.tokens     = record.tokens_size;
+            cache_save(cache, levels, &header, map, &record);
+        }
+    } else if (moved) {
+        /*
+         * Valid but the modification time or inode changed, save it again
+         * so the next load does not hash the content
+         */
+        header.statements = record.statements_size;
+        header.tokens     = record.tokens_size;
+        cache_save(cache, levels, &header, map, &record);
+    }
+    if (ret == PARSECONF_OK || record.error != PARSECONF_ERROR_NONE) {
+        ret = record_dispatch(&parser, &record, 1);
+    }
+    if (ret == PARSECONF_OK) {
+        ret = parse_flush(&parser);
+    }
+    include_free(&include);
+    parser_free(&parser);
+    record_free(&record);
+    syntax_free(levels);
+    munmap(map, st.st_size);
+
+    return ret;
+}
+
+int parseconf_file_cached(void* user, const char* file, const char* cache, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!cache) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_file_cached(user, file, cache, syntax, error_callback, 0);
+}
+
+int parseconf_file_cached_stat(void* user, const char* file, const char* cache, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!cache) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_file_cached(user, file, cache, syntax, error_callback, 1);
+}
+
+/*
+ * Reload
+ *
+ * The statements of the last reload are kept with a copy of their tokens
+ * and a fingerprint of the syntax entry and the tokens. A new reload
+ * records all statements of the file, statements that were there before
+ * are left alone, those that are gone are given to the remove callback and
+ * new ones to the callback, in that order. Included files are expanded in
+ * place, their statements are compared like those of the file itself.
+ *
+ * If a callback fails the state keeps what was actually applied, the
+ * statements that were not removed are kept and the new statements that
+ * were not added are left out, so the next reload tries them again.
+ */
+
+typedef struct reload_statement reload_statement_t;
+struct reload_statement {
+    const parseconf_syntax_t* syntax;
+    const parseconf_token_t*  tokens;
+    size_t                    token, line;
+    uint64_t                  hash;
+    int                       matched, keep;
+    size_t                    next;
+};
+
+typedef struct reload_state reload_state_t;
+struct reload_state {
+    arena_t             arena;
+    reload_statement_t* statements;
+    size_t              size;
+};
+
+struct parseconf_reload {
+    reload_state_t state;
+};
+
+int parseconf_reload_new(parseconf_reload_t** reload)
+{
+    if (!reload) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!(*reload = calloc(1, sizeof(parseconf_reload_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+
+    return PARSECONF_OK;
+}
+
+static void reload_state_free(reload_state_t* state)
+{
+    arena_free(&state->arena);
+    free(state->statements);
+}
+
+void parseconf_reload_free(parseconf_reload_t* reload)
+{
+    if (reload) {
+        reload_state_free(&reload->state);
+        free(reload);
+    }
+}
+
+static uint64_t reload_fingerprint(const parseconf_syntax_t* syntax, const parseconf_token_t* tokens)
+{
+    uint64_t hash = cache_hash(14695981039346656037ULL, &syntax, sizeof(syntax));
+
+    for (; tokens->type != PARSECONF_TOKEN_END; tokens++) {
+        uint64_t length = tokens->length;
+
+        hash = cache_hash(hash, &tokens->type, sizeof(tokens->type));
+        hash = cache_hash(hash, &length, sizeof(length));
+        hash = cache_hash(hash, tokens->token, tokens->length);
+    }
+
+    return hash;
+}
+
+static int reload_equal(const reload_statement_t* a, const reload_statement_t* b)
+{
+    const parseconf_token_t *x = a->tokens, *y = b->tokens;
+
+    if (a->hash != b->hash || a->syntax != b->syntax) {
+        return 0;
+    }
+    for (; x->type != PARSECONF_TOKEN_END && y->type != PARSECONF_TOKEN_END; x++, y++) {
+        if (x->type != y->type || x->length != y->length || memcmp(x->token, y->token, x->length)) {
+            return 0;
+        }
+    }
+
+    return x->type == y->type;
+}
+
+/*
+ * Copy the tokens of a statement into the arena of the state
+ */
+static int reload_tokens(reload_state_t* state, const parseconf_token_t* from, const parseconf_token_t** copy)
+{
+    parseconf_token_t* tokens;
+    size_t             size, i;
+
+    for (size = 0; from[size].type != PARSECONF_TOKEN_END; size++)
+        ;
+    if (!(tokens = arena_alloc(&state->arena, (size + 1) * sizeof(parseconf_token_t), sizeof(void*)))) {
+        return PARSECONF_ENOMEM;
+    }
+    memcpy(tokens, from, (size + 1) * sizeof(parseconf_token_t));
+    for (i = 0; i < size; i++) {
+        char* p;
+
+        if (!(p = arena_alloc(&state->arena, tokens[i].length + 1, 1))) {
+            return PARSECONF_ENOMEM;
+        }
+        memcpy(p, tokens[i].token, tokens[i].length);
+        p[tokens[i].length] = 0;
+        tokens[i].token     = p;
+    }
+    *copy = tokens;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Copy the recorded statements and their tokens into a new state
+ */
+static int reload_state(reload_state_t* state, const parse_record_t* record)
+{
+    size_t n;
+
+    memset(state, 0, sizeof(reload_state_t));
+    if (!record->statements_size) {
+        return PARSECONF_OK;
+    }
+    if (!(state->statements = calloc(record->statements_size, sizeof(reload_statement_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+
+    for (n = 0; n < record->statements_size; n++) {
+        if (reload_tokens(state, &record->tokens[record->statements[n].tokens], &state->statements[n].tokens) != PARSECONF_OK) {
+            return PARSECONF_ENOMEM;
+        }
+        state->statements[n].syntax = record->statements[n].syntax;
+        state->statements[n].token  = record->statements[n].token;
+        state->statements[n].line   = record->statements[n].line;
+        state->statements[n].hash   = reload_fingerprint(state->statements[n].syntax, state->statements[n].tokens);
+    }
+    state->size = record->statements_size;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * After a failed callback, reduce the new state to what is applied. New
+ * statements are kept if they were there before or marked as added, and
+ * old statements marked as not removed are copied over.
+ */
+static int reload_commit(reload_state_t* new, const reload_state_t* old)
+{
+    reload_statement_t* statements;
+    size_t              n, size, kept = 0;
+
+    for (n = 0; n < old->size; n++) {
+        if (old->statements[n].keep) {
+            kept++;
+        }
+    }
+    if (kept) {
+        if (!(statements = realloc(new->statements, (new->size + kept) * sizeof(reload_statement_t)))) {
+            return PARSECONF_ENOMEM;
+        }
+        new->statements = statements;
+    }
+
+    for (n = 0, size = 0; n < new->size; n++) {
+        if (new->statements[n].matched || new->statements[n].keep) {
+            new->statements[size++] = new->statements[n];
+        }
+    }
+    for (n = 0; n < old->size; n++) {
+        if (!old->statements[n].keep) {
+            continue;
+        }
+        new->statements[size] = old->statements[n];
+        if (reload_tokens(new, old->statements[n].tokens, &new->statements[size].tokens) != PARSECONF_OK) {
+            return PARSECONF_ENOMEM;
+        }
+        size++;
+    }
+    new->size = size;
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Mark the statements of the new state that are in the old state, and the
+ * other way around
+ */
+static int reload_match(reload_state_t* old, reload_state_t* new)
+{
+    size_t *table, size, mask, n, slot;
+
+    if (!old->size || !new->size) {
+        return PARSECONF_OK;
+    }
+    for (size = 16; size < old->size * 2; size <<= 1)
+        ;
+    mask = size - 1;
+    if (!(table = calloc(size * 2, sizeof(size_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+
+    /*
+     * Equal statements are grouped in one slot, the table holds the index
+     * plus one of the first statement of the group, which is used to
+     * compare with, and of the first that is not yet matched. The rest of
+     * the group is linked with `next` in order.
+     */
+    for (n = old->size; n--;) {
+        reload_statement_t* statement = &old->statements[n];
+
+        for (slot = statement->hash & mask; table[slot * 2]; slot = (slot + 1) & mask) {
+            if (reload_equal(&old->statements[table[slot * 2] - 1], statement)) {
+                break;
+            }
+        }
+        statement->next     = table[slot * 2 + 1];
+        table[slot * 2]     = n + 1;
+        table[slot * 2 + 1] = n + 1;
+    }
+    for (n = 0; n < new->size; n++) {
+        for (slot = new->statements[n].hash & mask; table[slot * 2]; slot = (slot + 1) & mask) {
+            if (reload_equal(&old->statements[table[slot * 2] - 1], &new->statements[n])) {
+                if (table[slot * 2 + 1]) {
+                    reload_statement_t* statement = &old->statements[table[slot * 2 + 1] - 1];
+
+                    statement->matched         = 1;
+                    new->statements[n].matched = 1;
+                    table[slot * 2 + 1]        = statement->next;
+                }
+                break;
+            }
+        }
+    }
+    free(table);
+
+    return PARSECONF_OK;
+}
+
+static int reload_read(int fd, char** buf, size_t* size)
+{
+    size_t  alloc = 0;
+    ssize_t n;
+    char*   p;
+
+    *buf  = 0;
+    *size = 0;
+    while (1) {
+        if (*size == alloc) {
+            alloc = alloc ? alloc * 2 : 4096;
+            if (!(p = realloc(*buf, alloc))) {
+                free(*buf);
+                return PARSECONF_ENOMEM;
+            }
+            *buf = p;
+        }
+        if ((n = read(fd, *buf + *size, alloc - *size)) < 0) {
+            free(*buf);
+            return PARSECONF_ERROR;
+        }
+        if (!n) {
+            break;
+        }
+        *size += n;
+    }
+
+    return PARSECONF_OK;
+}
+
+int parseconf_file_reload(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, parseconf_reload_t* reload)
+{
+    int                 fd, ret;
+    struct stat         st;
+    char*               buf    = 0;
+    void*               map    = 0;
+    size_t              size   = 0, n;
+    const char*         errstr = 0;
+    syntax_level_t*     levels;
+    parser_t            parser;
+    parse_record_t      record, expanded;
+    reload_state_t      state;
+    reload_statement_t* statement;
+    include_t           include;
+
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+    if (!reload) {
+        return PARSECONF_EINVAL;
+    }
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+        if (error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        return PARSECONF_ERROR;
+    }
+    if (fstat(fd, &st)) {
         if (error_callback)
             error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        close(fd);
+        return PARSECONF_ERROR;
+    }
+    if (S_ISREG(st.st_mode) && st.st_size && (unsigned long long)st.st_size <= (size_t)-1
+        && (map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+        size = st.st_size;
+    } else {
+        map = 0;
+        if ((ret = reload_read(fd, &buf, &size)) != PARSECONF_OK) {
+            if (ret == PARSECONF_ERROR && error_callback)
+                error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+            close(fd);
+            return ret;
+        }
+    }
+    close(fd);
+
+    if ((ret = syntax_compile(syntax, &levels)) != PARSECONF_OK) {
+        if (map)
+            munmap(map, size);
+        free(buf);
+        return ret;
+    }
+    parser_init(&parser, user, levels, error_callback);
+    memset(&include, 0, sizeof(include));
+    include.file   = file;
+    include.top    = 1;
+    include.dev    = st.st_dev;
+    include.ino    = st.st_ino;
+    parser.include = &include;
+
+    /*
+     * Check the whole file, and the files it includes, before calling any
+     * callbacks so that a broken config changes nothing
+     */
+    memset(&record, 0, sizeof(record));
+    memset(&expanded, 0, sizeof(expanded));
+    parser.record = &record;
+    ret           = parse_buffer(&parser, map ? (const char*)map : buf, size);
+    parser.record = 0;
+    if (record.error != PARSECONF_ERROR_NONE) {
+        if (error_callback)
+            error_callback(user, record.error, record.error_line, record.error_token, record.error_tokens == (size_t)-1 ? 0 : &record.tokens[record.error_tokens], 0);
+        ret = PARSECONF_ERROR;
+    }
+    if (ret == PARSECONF_OK) {
+        /*
+         * Included files are expanded in place so their statements are
+         * compared like those of the file itself
+         */
+        parser.expand = &expanded;
+        ret           = record_dispatch(&parser, &record, 1);
+        parser.expand = 0;
+    }
+    if (ret == PARSECONF_OK) {
+        ret = reload_state(&state, &expanded);
+        if (ret == PARSECONF_OK) {
+            ret = reload_match(&reload->state, &state);
+        }
+        if (ret != PARSECONF_OK) {
+            reload_state_free(&state);
+        }
+    }
+    record_free(&expanded);
+    record_free(&record);
+    include_free(&include);
+    parser.include = 0;
+    if (map)
+        munmap(map, size);
+    free(buf);
+    if (ret != PARSECONF_OK) {
+        parser_free(&parser);
+        syntax_free(levels);
+        return ret;
+    }
+
+    /*
+     * Statements that are gone are marked to be kept if their remove
+     * callback fails or is not called because an earlier one failed
+     */
+    for (n = reload->state.size, statement = reload->state.statements; n; n--, statement++) {
+        if (statement->matched) {
+            continue;
+        }
+        if (ret != PARSECONF_OK) {
+            statement->keep = 1;
+            continue;
+        }
+        if (!statement->syntax->remove_callback) {
+            continue;
+        }
+        errstr = "Syntax error or invalid arguments";
+        if (statement->syntax->remove_callback(user, statement->tokens, &errstr)) {
+            if (error_callback)
+                error_callback(user, PARSECONF_ERROR_CALLBACK, statement->line, statement->token, statement->tokens, errstr);
+            ret             = PARSECONF_ERROR;
+            statement->keep = 1;
+        }
+    }
+    parser.stable = 1;
+    for (n = state.size, statement = state.statements; ret == PARSECONF_OK && n; n--, statement++) {
+        if (!statement->matched) {
+            ret = parse_call(&parser, statement->syntax, statement->tokens, statement->token, statement->line);
+        }
+    }
+    if (ret == PARSECONF_OK) {
+        ret = parse_flush(&parser);
+    }
+    if (ret != PARSECONF_OK) {
+        int err;
+
+        /*
+         * New statements are called in order so the first `applied` of
+         * them were added
+         */
+        for (n = state.size, statement = state.statements; n && parser.applied; n--, statement++) {
+            if (!statement->matched) {
+                statement->keep = 1;
+                parser.applied--;
+            }
+        }
+        if ((err = reload_commit(&state, &reload->state)) != PARSECONF_OK) {
+            for (n = 0; n < reload->state.size; n++) {
+                reload->state.statements[n].matched = 0;
+                reload->state.statements[n].keep    = 0;
+            }
+            reload_state_free(&state);
+            parser_free(&parser);
+            syntax_free(levels);
+            return err;
+        }
+    }
+    for (n = 0; n < state.size; n++) {
+        state.statements[n].matched = 0;
+        state.statements[n].keep    = 0;
+    }
+    reload_state_free(&reload->state);
+    reload->state = state;
+
+    parser_free(&parser);
+    syntax_free(levels);
+
+    return ret;
+}
+
+/*
+ * Directory
+ *
+ * parseconf_dir() parses all files in a directory, except hidden ones, as
+ * if they were included in the order of their names. The files are read
+ * whole with pread() and recorded by a pool of threads, each taking the
+ * next file not yet taken, while the calling thread dispatches the records
+ * in order as they are done and takes the next file itself when it would
+ * otherwise wait for it. Only two files per thread are taken ahead of the
+ * one being dispatched, so a large directory is not held in memory at
+ * once. Files are handled like included files so they may include other
+ * files.
+ *
+ * With more than one thread each file has statistics of its own that are
+ * added, and its strings are interned, as it is dispatched so the ids are
+ * the same as with one thread. The line and token length limits and the
+ * time limit are checked by each file, limits on the bytes or statements
+ * can only be counted in order so such directories are loaded by the
+ * calling thread alone.
+ */
+
+typedef struct dir_file dir_file_t;
+struct dir_file {
+    char*             path;
+    char*             buf;
+    parse_record_t    record;
+    parseconf_stats_t stats;
+    int               ret, error, done;
+};
+
+typedef struct dir dir_t;
+struct dir {
+    const parser_t* parser;
+    parse_limits_t  limits;
+    dir_file_t*     files;
+    size_t          size, next, dispatched, window;
+    int             shared, stop;
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+};
+
+static int dir_compare(const void* a, const void* b)
+{
+    return strcmp(((const dir_file_t*)a)->path, ((const dir_file_t*)b)->path);
+}
+
+static void dir_free(dir_t* dir)
+{
+    size_t n;
+
+    for (n = 0; n < dir->size; n++) {
+        free(dir->files[n].path);
+        free(dir->files[n].buf);
+        record_free(&dir->files[n].record);
+    }
+    free(dir->files);
+}
+
+/*
+ * List the directory into `files` sorted by name
+ */
+static int dir_list(dir_t* dir, const char* path)
+{
+    DIR*           d;
+    struct dirent* entry;
+    size_t         alloc = 0, length = strlen(path);
+
+    if (!(d = opendir(path))) {
+        return PARSECONF_ERROR;
+    }
+    if (length && path[length - 1] == '/') {
+        length--;
+    }
+    while ((entry = readdir(d))) {
+        size_t name = strlen(entry->d_name);
+        char*  p;
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        if (dir->size == alloc) {
+            dir_file_t* files;
+
+            alloc = alloc ? alloc * 2 : 64;
+            if (!(files = realloc(dir->files, alloc * sizeof(dir_file_t)))) {
+                closedir(d);
+                return PARSECONF_ENOMEM;
+            }
+            dir->files = files;
+        }
+        if (!(p = malloc(length + name + 2))) {
+            closedir(d);
+            return PARSECONF_ENOMEM;
+        }
+        memcpy(p, path, length);
+        p[length] = '/';
+        memcpy(p + length + 1, entry->d_name, name + 1);
+        memset(&dir->files[dir->size], 0, sizeof(dir_file_t));
+        dir->files[dir->size++].path = p;
+    }
+    closedir(d);
+    if (dir->size) {
+        qsort(dir->files, dir->size, sizeof(dir_file_t), dir_compare);
+    }
+
+    return PARSECONF_OK;
+}
+
+/*
+ * Read and record the file, anything but regular files are skipped and
+ * errors in the file are recorded and reported when it is dispatched
+ */
+static int dir_load(const dir_t* dir, dir_file_t* file)
+{
+    parser_t       sub;
+    parse_limits_t limits = dir->limits;
+    struct stat    st;
+    size_t         size = 0;
+    ssize_t        n    = 0;
+    int            fd, ret;
+
+    if ((fd = open(file->path, O_RDONLY)) < 0 || fstat(fd, &st)) {
+        file->error = errno;
+        if (fd >= 0)
+            close(fd);
+        return PARSECONF_ERROR;
+    }
+    if (!S_ISREG(st.st_mode) || !st.st_size) {
+        close(fd);
+        return PARSECONF_OK;
+    }
+    if ((unsigned long long)st.st_size > (size_t)-1 || !(file->buf = malloc(st.st_size))) {
+        close(fd);
+        return PARSECONF_ENOMEM;
+    }
+    while (size < (size_t)st.st_size && (n = pread(fd, file->buf + size, st.st_size - size, size)) > 0) {
+        size += n;
+    }
+    if (n < 0) {
+        file->error = errno;
+        close(fd);
         return PARSECONF_ERROR;
     }
-    ret2 = getline(&buffer, &bufsize, fp);
-    buf  = buffer;
-    s    = bufsize;
-    line++;
-    while (ret2 > 0) {
-        memset(tokens, 0, sizeof(tokens));
-        /*
-         * Go to the first non white-space character
-         */
-        for (ret = PARSECONF_OK; *buf && s; buf++, s--) {
-            if (*buf != ' ' && *buf != '\t') {
-                if (*buf == '\n' || *buf == '\r') {
-                    ret = PARSECONF_EMPTY;
-                }
-                break;
-            }
+    close(fd);
+
+    parser_init(&sub, dir->parser->user, dir->parser->levels, dir->parser->error_callback);
+    sub.error_user = dir->parser->error_user;
+    sub.record     = &file->record;
+    sub.include    = dir->parser->include;
+    if (dir->shared) {
+        /*
+         * Loaded by the calling thread only, like an included file
+         */
+        sub.intern    = dir->parser->intern;
+        sub.limits    = dir->parser->limits;
+        sub.stats     = dir->parser->stats;
+        sub.stats_map = dir->parser->stats_map;
+    } else {
+        if (dir->parser->limits) {
+            sub.limits = &limits;
+        }
+        if (dir->parser->stats) {
+            sub.stats = &file->stats;
+        }
+    }
+    ret           = parse_buffer(&sub, file->buf, size);
+    sub.stats_map = 0;
+    parser_free(&sub);
+
+    return ret == PARSECONF_OK || file->record.error != PARSECONF_ERROR_NONE ? PARSECONF_OK : ret;
+}
+
+#if PARSECONF_ENABLE_THREADS
+static void* dir_thread(void* arg)
+{
+    dir_t* dir = (dir_t*)arg;
+    size_t n;
+    int    ret;
+
+    pthread_mutex_lock(&dir->lock);
+    while (!dir->stop && dir->next < dir->size) {
+        if (dir->next >= dir->dispatched + dir->window) {
+            pthread_cond_wait(&dir->cond, &dir->lock);
+            continue;
+        }
+        n = dir->next++;
+        pthread_mutex_unlock(&dir->lock);
+        ret = dir_load(dir, &dir->files[n]);
+        pthread_mutex_lock(&dir->lock);
+        dir->files[n].ret  = ret;
+        dir->files[n].done = 1;
+        pthread_cond_broadcast(&dir->cond);
+    }
+    pthread_mutex_unlock(&dir->lock);
+
+    return 0;
+}
+#endif
+
+/*
+ * Wait for the file to be done or load it if no thread has taken it
+ */
+static void dir_wait(dir_t* dir, size_t n)
+{
+#if PARSECONF_ENABLE_THREADS
+    int ret;
+
+    pthread_mutex_lock(&dir->lock);
+    if (!dir->files[n].done && dir->next == n) {
+        dir->next++;
+        pthread_mutex_unlock(&dir->lock);
+        ret = dir_load(dir, &dir->files[n]);
+        pthread_mutex_lock(&dir->lock);
+        dir->files[n].ret  = ret;
+        dir->files[n].done = 1;
+    }
+    while (!dir->files[n].done) {
+        pthread_cond_wait(&dir->cond, &dir->lock);
+    }
+    pthread_mutex_unlock(&dir->lock);
+#else
+    dir->files[n].ret  = dir_load(dir, &dir->files[n]);
+    dir->files[n].done = 1;
+#endif
+}
+
+static int parse_dir(void* user, const char* path, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads, const parseconf_options_t* options)
+{
+    syntax_level_t* levels;
+    parser_t        parser;
+    parse_limits_t  limits;
+    include_t       include;
+    dir_t           dir;
+    dir_file_t*     file;
+    size_t          n;
+    int             ret;
+#if PARSECONF_ENABLE_THREADS
+    pthread_t* thread = 0;
+    size_t     started = 0;
+#endif
+
+    memset(&dir, 0, sizeof(dir));
+    if ((ret = dir_list(&dir, path)) != PARSECONF_OK) {
+        if (ret == PARSECONF_ERROR && error_callback)
+            error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, 0);
+        dir_free(&dir);
+        return ret;
+    }
+    if ((ret = syntax_compile(syntax, &levels)) != PARSECONF_OK) {
+        dir_free(&dir);
+        return ret;
+    }
+    parser_init(&parser, user, levels, error_callback);
+    if ((ret = parser_options(&parser, options, &limits)) != PARSECONF_OK) {
+        parser_free(&parser);
+        syntax_free(levels);
+        dir_free(&dir);
+        return ret;
+    }
+    memset(&include, 0, sizeof(include));
+    parser.include = &include;
+    dir.parser     = &parser;
+
+    if (!threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 0 ? cpus : 1;
+    }
+    if (parser.limits) {
+        if (parser.limits->limits.bytes || parser.limits->limits.statements) {
+            /*
+             * Must be counted in order, see above
+             */
+            threads = 1;
+        }
+        dir.limits = *parser.limits;
+    }
+#if PARSECONF_ENABLE_THREADS
+    /*
+     * The calling thread loads files too so one thread less is started
+     */
+    if (threads > dir.size) {
+        threads = dir.size;
+    }
+    dir.shared = threads < 2;
+    dir.window = threads * 2;
+    pthread_mutex_init(&dir.lock, 0);
+    pthread_cond_init(&dir.cond, 0);
+    if (threads > 1 && (thread = calloc(threads - 1, sizeof(pthread_t)))) {
+        for (; started < threads - 1; started++) {
+            if (pthread_create(&thread[started], 0, dir_thread, &dir)) {
+                break;
+            }
+        }
+    }
+#else
+    dir.shared = 1;
+#endif
+
+    for (n = 0, ret = PARSECONF_OK; ret == PARSECONF_OK && n < dir.size; n++) {
+        file = &dir.files[n];
+        dir_wait(&dir, n);
+        if (file->ret == PARSECONF_ERROR) {
+            if (error_callback) {
+                errno = file->error;
+                error_callback(user, PARSECONF_ERROR_FILE_ERRNO, 0, 0, 0, file->path);
+            }
+            ret = PARSECONF_ERROR;
+        } else {
+            if (!dir.shared && parser.stats) {
+                parser.stats->bytes += file->stats.bytes;
+                parser.stats->lines += file->stats.lines;
+                stats_add(parser.stats, &file->stats);
+            }
+            if (file->ret != PARSECONF_OK) {
+                ret = file->ret;
+            } else if (dir.shared || !parser.intern || (ret = record_intern(parser.intern, &file->record)) == PARSECONF_OK) {
+                ret = include_dispatch(&parser, &file->record, file->path);
+            }
+        }
+        /*
+         * Records are freed as they are dispatched as the directory may
+         * be large
+         */
+        record_free(&file->record);
+        memset(&file->record, 0, sizeof(file->record));
+        free(file->buf);
+        file->buf = 0;
+#if PARSECONF_ENABLE_THREADS
+        pthread_mutex_lock(&dir.lock);
+        dir.dispatched = n + 1;
+        pthread_cond_broadcast(&dir.cond);
+        pthread_mutex_unlock(&dir.lock);
+#endif
+    }
+    if (ret == PARSECONF_OK) {
+        ret = parse_flush(&parser);
+    }
+
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_lock(&dir.lock);
+    dir.stop = 1;
+    pthread_cond_broadcast(&dir.cond);
+    pthread_mutex_unlock(&dir.lock);
+    for (n = 0; n < started; n++) {
+        pthread_join(thread[n], 0);
+    }
+    free(thread);
+    pthread_cond_destroy(&dir.cond);
+    pthread_mutex_destroy(&dir.lock);
+#endif
+    dir_free(&dir);
+    include_free(&include);
+    parser_free(&parser);
+    syntax_free(levels);
+
+    return ret;
+}
+
+int parseconf_dir(void* user, const char* path, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads)
+{
+    if (!path) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_dir(user, path, syntax, error_callback, threads, 0);
+}
+
+int parseconf_dir_options(void* user, const char* path, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options)
+{
+    if (!path) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+    if (!options) {
+        return PARSECONF_EINVAL;
+    }
+
+    return parse_dir(user, path, syntax, error_callback, options->threads ? options->threads : 1, options);
+}
+
+/*
+ * Watch
+ *
+ * A watch parses a file into snapshots created by the caller and publishes
+ * them for readers. A reader enters before using the current snapshot and
+ * leaves when done with it, which only stores the current epoch in the
+ * reader and loads the snapshot so readers never block on enter.
+ *
+ * A new snapshot is published by swapping the pointer and increasing the
+ * epoch, the old snapshot is freed when all readers have left or entered
+ * in the new epoch. If a parse fails the new snapshot is freed and the
+ * current one is kept. The lock of the watch is only held to parse and
+ * swap, and to check the readers, the reload then sleeps on a condition
+ * that is signalled by readers leaving while it is waiting, so readers can
+ * be added and removed meanwhile. A reader must not stay entered for long,
+ * it holds back freeing the old snapshot and the reload waits for it,
+ * enter and leave around each use instead.
+ *
+ * Readers are owned by the caller and must be freed before the watch.
+ *
+ * With PARSECONF_ENABLE_WATCH the file, all included files and the
+ * directories of include patterns are watched with inotify by a thread
+ * that reloads once the changes have settled for PARSECONF_WATCH_DELAY
+ * milliseconds. Without it the caller reloads with parseconf_watch_reload().
+ */
+
+#if PARSECONF_ENABLE_WATCH
+#define PARSECONF_WATCH_DELAY 100
+#define PARSECONF_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+#endif
+
+typedef struct watch_path watch_path_t;
+struct watch_path {
+    int   wd;
+    char* name;
+};
+
+struct parseconf_watch_reader {
+    uint64_t                  epoch;
+    parseconf_watch_reader_t* next;
+    parseconf_watch_t*        watch;
+};
+
+struct parseconf_watch {
+    void*                     snapshot;
+    uint64_t                  epoch;
+    parseconf_watch_reader_t* readers;
+
+    char*                      file;
+    const parseconf_syntax_t*  syntax;
+    parseconf_error_callback_t error_callback;
+    parseconf_snapshot_new_t   snapshot_new;
+    parseconf_snapshot_free_t  snapshot_free;
+    void*                      arg;
+
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    unsigned int    waiting;
+#endif
+#if PARSECONF_ENABLE_WATCH
+    pthread_t     thread;
+    int           started, fd, stop[2];
+    watch_path_t* paths;
+    size_t        paths_size, paths_alloc;
+#endif
+};
+
+static void watch_lock(parseconf_watch_t* watch)
+{
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_lock(&watch->lock);
+#else
+    (void)watch;
+#endif
+}
+
+static void watch_unlock(parseconf_watch_t* watch)
+{
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_unlock(&watch->lock);
+#else
+    (void)watch;
+#endif
+}
+
+static void* watch_arg(parseconf_watch_t* watch)
+{
+    return watch->arg;
+}
+
+/*
+ * Watch the directory of `path` for changes to the file, or to any file if
+ * `any` is set, errors are ignored since the watch is only a trigger
+ */
+static void watch_add(parseconf_watch_t* watch, const char* path, int any)
+{
+#if PARSECONF_ENABLE_WATCH
+    const char* slash = strrchr(path, '/');
+    const char* name  = slash ? slash + 1 : path;
+    char*       dir;
+    size_t      n;
+    int         wd;
+
+    if (slash) {
+        if (!(dir = malloc(slash - path + 2))) {
+            return;
+        }
+        memcpy(dir, path, slash - path + 1);
+        dir[slash - path + 1] = 0;
+    } else if (!(dir = strdup("."))) {
+        return;
+    }
+    wd = inotify_add_watch(watch->fd, dir, PARSECONF_WATCH_MASK);
+    free(dir);
+    if (wd < 0) {
+        return;
+    }
+
+    for (n = 0; n < watch->paths_size; n++) {
+        if (watch->paths[n].wd == wd && (any ? !watch->paths[n].name : watch->paths[n].name && !strcmp(watch->paths[n].name, name))) {
+            return;
         }
-        /*
-         * Parse all the tokens
-         */
-        for (i = 0; i < PARSECONF_MAX_TOKENS && ret == PARSECONF_OK; i++) {
-            ret = parse_token(&buf, &s, &tokens[i]);
+    }
+    if (watch->paths_size == watch->paths_alloc) {
+        size_t        alloc = watch->paths_alloc ? watch->paths_alloc * 2 : 16;
+        watch_path_t* p;
+
+        if (!(p = realloc(watch->paths, alloc * sizeof(watch_path_t)))) {
+            return;
         }
+        watch->paths       = p;
+        watch->paths_alloc = alloc;
+    }
+    watch->paths[watch->paths_size].wd   = wd;
+    watch->paths[watch->paths_size].name = 0;
+    if (!any && !(watch->paths[watch->paths_size].name = strdup(name))) {
+        return;
+    }
+    watch->paths_size++;
+#else
+    (void)watch;
+    (void)path;
+    (void)any;
+#endif
+}
 
-        if (ret == PARSECONF_COMMENT) {
-            /*
-             * Line ended with comment, reduce the number of tokens
-             */
-            i--;
-        } else if (ret == PARSECONF_EMPTY) {
-            i = 0;
-        } else if (ret == PARSECONF_OK) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_TOO_MANY_ARGUMENTS, line, 0, tokens, 0);
-            free(buffer);
-            fclose(fp);
-            return PARSECONF_ERROR;
-        } else if (ret != PARSECONF_LAST) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_INVALID_SYNTAX, line, 0, tokens, 0);
-            free(buffer);
-            fclose(fp);
-            return PARSECONF_ERROR;
+/*
+ * Non-zero if any reader is still entered in an epoch before `epoch`,
+ * called with the lock
+ */
+static int watch_entered(parseconf_watch_t* watch, uint64_t epoch)
+{
+    parseconf_watch_reader_t* reader;
+    uint64_t                  current;
+
+    for (reader = watch->readers; reader; reader = reader->next) {
+        if ((current = __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST)) && current < epoch) {
+            return 1;
         }
+    }
 
-        if (i) {
-            /*
-             * Config using the tokens
-             */
-            if (parse_tokens(user, syntax, tokens, i, line, error_callback) != PARSECONF_OK) {
-                free(buffer);
-                fclose(fp);
-                return PARSECONF_ERROR;
+    return 0;
+}
+
+/*
+ * Wait until all readers have left or entered in a new epoch, called
+ * without the lock. `waiting` is set before the readers are checked and
+ * readers check it after leaving, so a reader that leaves after the check
+ * signals the condition.
+ */
+static void watch_synchronize(parseconf_watch_t* watch)
+{
+    uint64_t epoch = __atomic_add_fetch(&watch->epoch, 1, __ATOMIC_SEQ_CST);
+#if PARSECONF_ENABLE_THREADS
+
+    __atomic_add_fetch(&watch->waiting, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&watch->lock);
+    while (watch_entered(watch, epoch)) {
+        pthread_cond_wait(&watch->cond, &watch->lock);
+    }
+    pthread_mutex_unlock(&watch->lock);
+    __atomic_sub_fetch(&watch->waiting, 1, __ATOMIC_SEQ_CST);
+#else
+    /*
+     * Without threads nothing signals a reader leaving, poll with a
+     * growing sleep
+     */
+    struct timespec wait = { 0, 100000 };
+
+    while (watch_entered(watch, epoch)) {
+        nanosleep(&wait, 0);
+        if (wait.tv_nsec < 100000000) {
+            wait.tv_nsec *= 2;
+        }
+    }
+#endif
+}
+
+int parseconf_watch_reload(parseconf_watch_t* watch)
+{
+    void *snapshot, *old;
+    int   ret;
+
+    if (!watch) {
+        return PARSECONF_EINVAL;
+    }
+
+    watch_lock(watch);
+    if (!(snapshot = watch->snapshot_new(watch->arg))) {
+        watch_unlock(watch);
+        return PARSECONF_ENOMEM;
+    }
+    if ((ret = parse_file(snapshot, watch->file, watch->syntax, watch->error_callback, 0, watch)) != PARSECONF_OK) {
+        watch->snapshot_free(watch->arg, snapshot);
+        watch_unlock(watch);
+        return ret;
+    }
+    old = __atomic_exchange_n(&watch->snapshot, snapshot, __ATOMIC_SEQ_CST);
+    watch_unlock(watch);
+
+    /*
+     * A reload started meanwhile swaps out this snapshot and waits for
+     * its own epoch, so each old snapshot is freed once
+     */
+    if (old) {
+        watch_synchronize(watch);
+        watch->snapshot_free(watch->arg, old);
+    }
+
+    return PARSECONF_OK;
+}
+
+#if PARSECONF_ENABLE_WATCH
+/*
+ * Read the pending events, returns non-zero if any of them is for a
+ * watched file
+ */
+static int watch_events(parseconf_watch_t* watch)
+{
+    char                        buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event* event;
+    ssize_t                     n;
+    size_t                      i;
+    char*                       p;
+    int                         changed = 0;
+
+    watch_lock(watch);
+    while ((n = read(watch->fd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + n; p += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event*)p;
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed = 1;
+                continue;
+            }
+            for (i = 0; !changed && i < watch->paths_size; i++) {
+                if (watch->paths[i].wd == event->wd && (!watch->paths[i].name || (event->len && !strcmp(watch->paths[i].name, event->name)))) {
+                    changed = 1;
+                }
             }
         }
+    }
+    watch_unlock(watch);
 
-        if (ret == PARSECONF_COMMENT || !s || !*buf || *buf == '\n' || *buf == '\r') {
-            ret2 = getline(&buffer, &bufsize, fp);
-            buf  = buffer;
-            s    = bufsize;
-            line++;
+    return changed;
+}
+
+static void* watch_thread(void* arg)
+{
+    parseconf_watch_t* watch = (parseconf_watch_t*)arg;
+    struct pollfd      fds[2];
+    int                changed = 0, n;
+
+    fds[0].fd     = watch->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = watch->stop[0];
+    fds[1].events = POLLIN;
+
+    while ((n = poll(fds, 2, changed ? PARSECONF_WATCH_DELAY : -1)) >= 0 || errno == EINTR) {
+        if (n < 0) {
+            continue;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (!n) {
+            /*
+             * Changes have settled, errors are reported to the error
+             * callback and the current snapshot is kept
+             */
+            changed = 0;
+            parseconf_watch_reload(watch);
+            continue;
+        }
+        if (watch_events(watch)) {
+            changed = 1;
         }
     }
-    if (ret2 < 0) {
-        long pos;
 
-        pos = ftell(fp);
-        if (fseek(fp, 0, SEEK_END)) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_FILE_ERRNO, line, 0, 0, 0);
-        } else if (ftell(fp) < pos) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_FILE_ERRNO, line, 0, 0, 0);
+    return 0;
+}
+#endif
+
+int parseconf_watch_new(parseconf_watch_t** watch, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, parseconf_snapshot_new_t snapshot_new, parseconf_snapshot_free_t snapshot_free, void* arg)
+{
+    parseconf_watch_t* w;
+    int                ret;
+
+    if (!watch) {
+        return PARSECONF_EINVAL;
+    }
+    if (!file) {
+        return PARSECONF_EINVAL;
+    }
+    if (!syntax) {
+        return PARSECONF_EINVAL;
+    }
+    if (!snapshot_new) {
+        return PARSECONF_EINVAL;
+    }
+    if (!snapshot_free) {
+        return PARSECONF_EINVAL;
+    }
+
+    if (!(w = calloc(1, sizeof(parseconf_watch_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    if (!(w->file = strdup(file))) {
+        free(w);
+        return PARSECONF_ENOMEM;
+    }
+    w->epoch          = 1;
+    w->syntax         = syntax;
+    w->error_callback = error_callback;
+    w->snapshot_new   = snapshot_new;
+    w->snapshot_free  = snapshot_free;
+    w->arg            = arg;
+#if PARSECONF_ENABLE_THREADS
+    pthread_mutex_init(&w->lock, 0);
+    pthread_cond_init(&w->cond, 0);
+#endif
+#if PARSECONF_ENABLE_WATCH
+    w->stop[0] = w->stop[1] = -1;
+    if ((w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0 || pipe(w->stop)) {
+        parseconf_watch_free(w);
+        return PARSECONF_ERROR;
+    }
+#endif
+
+    if ((ret = parseconf_watch_reload(w)) != PARSECONF_OK) {
+        parseconf_watch_free(w);
+        return ret;
+    }
+
+#if PARSECONF_ENABLE_WATCH
+    if (pthread_create(&w->thread, 0, watch_thread, w)) {
+        parseconf_watch_free(w);
+        return PARSECONF_ERROR;
+    }
+    w->started = 1;
+#endif
+
+    *watch = w;
+    return PARSECONF_OK;
+}
+
+void parseconf_watch_free(parseconf_watch_t* watch)
+{
+    if (!watch) {
+        return;
+    }
+
+#if PARSECONF_ENABLE_WATCH
+    if (watch->started) {
+        char stop = 0;
+
+        if (write(watch->stop[1], &stop, 1) == 1) {
+            pthread_join(watch->thread, 0);
         }
     }
-    free(buffer);
-    fclose(fp);
+    if (watch->fd >= 0)
+        close(watch->fd);
+    if (watch->stop[0] >= 0)
+        close(watch->stop[0]);
+    if (watch->stop[1] >= 0)
+        close(watch->stop[1]);
+    for (; watch->paths_size; watch->paths_size--) {
+        free(watch->paths[watch->paths_size - 1].name);
+    }
+    free(watch->paths);
+#endif
+    /*
+     * Readers are freed by the caller before the watch
+     */
+    parseconf_assert(!watch->readers);
+#if PARSECONF_ENABLE_THREADS
+    pthread_cond_destroy(&watch->cond);
+    pthread_mutex_destroy(&watch->lock);
+#endif
+    if (watch->snapshot) {
+        watch->snapshot_free(watch->arg, watch->snapshot);
+    }
+    free(watch->file);
+    free(watch);
+}
+
+int parseconf_watch_reader_new(parseconf_watch_t* watch, parseconf_watch_reader_t** reader)
+{
+    void* r;
+
+    if (!watch) {
+        return PARSECONF_EINVAL;
+    }
+    if (!reader) {
+        return PARSECONF_EINVAL;
+    }
+
+    /*
+     * Readers are on their own cache line since their epoch is written on
+     * every enter and leave
+     */
+    if (posix_memalign(&r, 64, sizeof(parseconf_watch_reader_t) > 64 ? sizeof(parseconf_watch_reader_t) : 64)) {
+        return PARSECONF_ENOMEM;
+    }
+    memset(r, 0, sizeof(parseconf_watch_reader_t));
+    *reader          = (parseconf_watch_reader_t*)r;
+    (*reader)->watch = watch;
+
+    watch_lock(watch);
+    (*reader)->next = watch->readers;
+    watch->readers  = *reader;
+    watch_unlock(watch);
 
     return PARSECONF_OK;
 }
 
-int parseconf_text(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+void parseconf_watch_reader_free(parseconf_watch_reader_t* reader)
 {
-    const char*       buf;
-    size_t            s, i, line = 0;
-    parseconf_token_t tokens[PARSECONF_MAX_TOKENS];
-    int               ret;
+    parseconf_watch_reader_t** p;
 
-    if (!text) {
+    if (!reader) {
+        return;
+    }
+
+    watch_lock(reader->watch);
+    for (p = &reader->watch->readers; *p; p = &(*p)->next) {
+        if (*p == reader) {
+            *p = reader->next;
+            break;
+        }
+    }
+    watch_unlock(reader->watch);
+    free(reader);
+}
+
+void* parseconf_watch_enter(parseconf_watch_reader_t* reader)
+{
+    __atomic_store_n(&reader->epoch, __atomic_load_n(&reader->watch->epoch, __ATOMIC_ACQUIRE), __ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&reader->watch->snapshot, __ATOMIC_SEQ_CST);
+}
+
+void parseconf_watch_leave(parseconf_watch_reader_t* reader)
+{
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_SEQ_CST);
+#if PARSECONF_ENABLE_THREADS
+    if (__atomic_load_n(&reader->watch->waiting, __ATOMIC_SEQ_CST)) {
+        /*
+         * A reload is waiting for readers, the lock makes sure it is
+         * either still checking or already waiting on the condition
+         */
+        pthread_mutex_lock(&reader->watch->lock);
+        pthread_cond_broadcast(&reader->watch->cond);
+        pthread_mutex_unlock(&reader->watch->lock);
+    }
+#endif
+}
+
+/*
+ * Streaming
+ */
+
+struct parseconf_stream {
+    parser_t        parser;
+    syntax_level_t* levels;
+    int             error;
+    parse_limits_t  limits;
+
+    char*  buffer;
+    size_t size, bufsize;
+};
+
+int parseconf_stream_new(parseconf_stream_t** stream, void* user, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback)
+{
+    parseconf_stream_t* s;
+    int                 ret;
+
+    if (!stream) {
         return PARSECONF_EINVAL;
     }
     if (!syntax) {
         return PARSECONF_EINVAL;
     }
 
-    memset(tokens, 0, sizeof(tokens));
-    buf = text;
-    s   = length;
-    line++;
+    if (!(s = calloc(1, sizeof(parseconf_stream_t)))) {
+        return PARSECONF_ENOMEM;
+    }
+    if ((ret = syntax_compile(syntax, &s->levels)) != PARSECONF_OK) {
+        free(s);
+        return ret;
+    }
+    parser_init(&s->parser, user, s->levels, error_callback);
+
+    *stream = s;
+    return PARSECONF_OK;
+}
 
-    while (1) {
+void parseconf_stream_free(parseconf_stream_t* stream)
+{
+    if (stream) {
+        parser_free(&stream->parser);
+        syntax_free(stream->levels);
+        free(stream->buffer);
+        free(stream);
+    }
+}
+
+static int stream_buffer(parseconf_stream_t* stream, const char* data, size_t length)
+{
+    if (stream->parser.limits && stream->parser.limits->limits.line_length && stream->size + length > stream->parser.limits->limits.line_length + 1) {
         /*
-         * Go to the first non white-space character
+         * Partial line, and its newline, is longer than the limit
          */
-        for (ret = PARSECONF_OK; *buf && s; buf++, s--) {
-            if (*buf != ' ' && *buf != '\t') {
-                if (*buf == '\n' || *buf == '\t') {
-                    ret = PARSECONF_EMPTY;
-                }
-                break;
-            }
+        stream->error = 1;
+        return parse_error(&stream->parser, PARSECONF_ERROR_LINE_TOO_LONG, 0, 0, 0);
+    }
+    if (stream->size + length > stream->bufsize) {
+        size_t bufsize = stream->bufsize ? stream->bufsize : 256;
+        char*  buffer;
+
+        while (bufsize < stream->size + length) {
+            bufsize *= 2;
         }
-        /*
-         * Parse all the tokens
-         */
-        for (i = 0; i < PARSECONF_MAX_TOKENS && ret == PARSECONF_OK; i++) {
-            ret = parse_token(&buf, &s, &tokens[i]);
+        if (!(buffer = realloc(stream->buffer, bufsize))) {
+            return PARSECONF_ENOMEM;
+        }
+        stream->buffer  = buffer;
+        stream->bufsize = bufsize;
+        if (stream->parser.stats && bufsize > stream->parser.stats->buffer_peak) {
+            stream->parser.stats->buffer_peak = bufsize;
         }
+    }
+    memcpy(stream->buffer + stream->size, data, length);
+    stream->size += length;
 
-        if (ret == PARSECONF_COMMENT) {
-            /*
-             * Line ended with comment, reduce the number of tokens
-             */
-            i--;
-            if (!i) {
-                /*
-                 * Comment was the only token so the line is empty
-                 */
-                return PARSECONF_OK;
-            }
-        } else if (ret == PARSECONF_EMPTY) {
-            i = 0;
-        } else if (ret == PARSECONF_OK) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_TOO_MANY_ARGUMENTS, line, 0, tokens, 0);
-            return PARSECONF_ERROR;
-        } else if (ret != PARSECONF_LAST) {
-            if (error_callback)
-                error_callback(user, PARSECONF_ERROR_INVALID_SYNTAX, line, 0, tokens, 0);
-            return PARSECONF_ERROR;
+    return PARSECONF_OK;
+}
+
+int parseconf_stream_feed(parseconf_stream_t* stream, const char* data, size_t length)
+{
+    const char* nl;
+    int         ret;
+
+    if (!stream) {
+        return PARSECONF_EINVAL;
+    }
+    if (!data && length) {
+        return PARSECONF_EINVAL;
+    }
+    if (stream->error) {
+        return PARSECONF_ERROR;
+    }
+    if (!length) {
+        return PARSECONF_OK;
+    }
+
+    /*
+     * Statements never span lines so only complete lines are parsed and a
+     * partial line is kept until the rest of it arrives
+     */
+    if (stream->size) {
+        if (!(nl = memchr(data, '\n', length))) {
+            return stream_buffer(stream, data, length);
+        }
+        nl++;
+        if ((ret = stream_buffer(stream, data, nl - data)) != PARSECONF_OK) {
+            return ret;
         }
+        length -= nl - data;
+        data = nl;
 
+        ret          = parse_buffer(&stream->parser, stream->buffer, stream->size);
+        stream->size = 0;
+        if (ret != PARSECONF_OK) {
+            stream->error = 1;
+            return ret;
+        }
+    }
+
+    for (nl = data + length; nl > data && nl[-1] != '\n'; nl--)
+        ;
+    if (nl > data) {
         /*
-         * Configure using the tokens
+         * Parse all complete lines directly from the given data
          */
-        if (i && parse_tokens(user, syntax, tokens, i, line, error_callback) != PARSECONF_OK) {
-            return PARSECONF_ERROR;
+        if ((ret = parse_buffer(&stream->parser, data, nl - data)) != PARSECONF_OK) {
+            stream->error = 1;
+            return ret;
         }
+    }
 
-        if (ret == PARSECONF_COMMENT || !s || !*buf || *buf == '\n' || *buf == '\r') {
-            break;
-        }
+    return stream_buffer(stream, nl, length - (nl - data));
+}
+
+int parseconf_stream_finish(parseconf_stream_t* stream)
+{
+    int ret;
+
+    if (!stream) {
+        return PARSECONF_EINVAL;
+    }
+    if (stream->error) {
+        return PARSECONF_ERROR;
     }
 
-    return PARSECONF_OK;
+    /*
+     * Parse the last line which did not end with a newline
+     */
+    ret          = parse_buffer(&stream->parser, stream->buffer, stream->size);
+    stream->size = 0;
+    if (ret == PARSECONF_OK) {
+        ret = parse_flush(&stream->parser);
+    }
+    if (ret != PARSECONF_OK) {
+        stream->error = 1;
+    }
+
+    return ret;
+}
+
+int parseconf_stream_options(parseconf_stream_t* stream, const parseconf_options_t* options)
+{
+    if (!stream) {
+        return PARSECONF_EINVAL;
+    }
+    if (!options) {
+        return PARSECONF_EINVAL;
+    }
+    if (options->threads > 1) {
+        return PARSECONF_EINVAL;
+    }
+
+    /*
+     * The time starts when the limits are set
+     */
+    return parser_options(&stream->parser, options, &stream->limits);
 }
 
 /*
@@ -23,6 +23,7 @@
 #define __parseconf_h
 
 #include <stddef.h>
+#include <stdint.h>
 #if PARSECONF_ENABLE_ASSERT
 #include <assert.h>
 #define parseconf_assert(x) assert(x)
@@ -51,7 +52,11 @@
 #define PARSECONF_EINVAL_STR    "Invalid arguments"
 #define PARSECONF_ERROR_STR     "Generic error"
 
+/* Deprecated, no longer a limit, kept for source compatibility */
 #define PARSECONF_MAX_TOKENS    64
+#define PARSECONF_BATCH_SIZE    256
+#define PARSECONF_LIMITS_LINES  1024
+#define PARSECONF_CHUNK_SIZE    262144
 
 /* clang-format on */
 
@@ -77,7 +82,13 @@ enum parseconf_token_type {
     ANY,
     FLOAT,
     FLOATS,
-    NESTED
+    NESTED,
+    IPADDR,
+    PREFIX,
+    IPADDRS,
+    PREFIXES,
+    DURATION,
+    SIZE
 };
 #define PARSECONF_TOKEN_END END
 #define PARSECONF_TOKEN_STRING STRING
@@ -90,6 +101,12 @@ enum parseconf_token_type {
 #define PARSECONF_TOKEN_FLOAT FLOAT
 #define PARSECONF_TOKEN_FLOATS FLOATS
 #define PARSECONF_TOKEN_NESTED NESTED
+#define PARSECONF_TOKEN_IPADDR IPADDR
+#define PARSECONF_TOKEN_PREFIX PREFIX
+#define PARSECONF_TOKEN_IPADDRS IPADDRS
+#define PARSECONF_TOKEN_PREFIXES PREFIXES
+#define PARSECONF_TOKEN_DURATION DURATION
+#define PARSECONF_TOKEN_SIZE SIZE
 #else
 enum parseconf_token_type {
     PARSECONF_TOKEN_END = 0,
@@ -102,19 +119,58 @@ enum parseconf_token_type {
     PARSECONF_TOKEN_ANY,
     PARSECONF_TOKEN_FLOAT,
     PARSECONF_TOKEN_FLOATS,
-    PARSECONF_TOKEN_NESTED
+    PARSECONF_TOKEN_NESTED,
+    PARSECONF_TOKEN_IPADDR,
+    PARSECONF_TOKEN_PREFIX,
+    PARSECONF_TOKEN_IPADDRS,
+    PARSECONF_TOKEN_PREFIXES,
+    PARSECONF_TOKEN_DURATION,
+    PARSECONF_TOKEN_SIZE
 };
 #endif
+#define PARSECONF_TOKEN_TYPES (PARSECONF_TOKEN_SIZE + 1)
+
+/*
+ * IPADDR and PREFIX tokens also have the address parsed, `family` is
+ * AF_INET or AF_INET6 and `data.address` holds the address in network
+ * byte order, IPv4 uses the first 4 bytes. `prefix` is the prefix length,
+ * for IPADDR it is the full length of the address.
+ *
+ * DURATION and SIZE tokens also have `data.value` converted, nanoseconds
+ * for a duration with one of the suffixes ns, us, ms, s, m, h, d or w and
+ * bytes for a size with the suffix B or one of k, K, M, G or T, optionally
+ * followed by B, in powers of 1024. Values that overflow are left as
+ * strings.
+ *
+ * `data.address` and `data.value` share storage, only the one of the
+ * token's type is set. The first members are the same as in earlier
+ * versions, code built against an earlier layout of this structure must
+ * be rebuilt.
+ */
 
 typedef struct parseconf_token parseconf_token_t;
 struct parseconf_token {
     parseconf_token_type_t type;
     const char*            token;
     size_t                 length;
+    unsigned int           id;
+    unsigned char          family, prefix;
+    union {
+        unsigned char address[16];
+        uint64_t      value;
+    } data;
 };
 
 typedef int (*parseconf_token_callback_t)(void* user, const parseconf_token_t* tokens, const char** errstr);
 
+typedef struct parseconf_statement parseconf_statement_t;
+struct parseconf_statement {
+    const parseconf_token_t* tokens;
+    size_t                   line;
+};
+
+typedef int (*parseconf_batch_callback_t)(void* user, const parseconf_statement_t* statements, size_t size, size_t* failed, const char** errstr);
+
 typedef enum parseconf_error parseconf_error_t;
 enum parseconf_error {
     PARSECONF_ERROR_NONE = 0,
@@ -130,14 +186,24 @@ enum parseconf_error {
     PARSECONF_ERROR_CALLBACK,
     PARSECONF_ERROR_FILE_ERRNO,
     PARSECONF_ERROR_TOO_MANY_ARGUMENTS,
-    PARSECONF_ERROR_INVALID_SYNTAX
+    PARSECONF_ERROR_INVALID_SYNTAX,
+    PARSECONF_ERROR_INCLUDE_CYCLE,
+    PARSECONF_ERROR_LINE_TOO_LONG,
+    PARSECONF_ERROR_TOKEN_TOO_LONG,
+    PARSECONF_ERROR_TOO_MANY_BYTES,
+    PARSECONF_ERROR_TOO_MANY_STATEMENTS,
+    PARSECONF_ERROR_TIMEOUT,
+    PARSECONF_ERROR_EXPECT_IPADDR,
+    PARSECONF_ERROR_EXPECT_PREFIX,
+    PARSECONF_ERROR_EXPECT_DURATION,
+    PARSECONF_ERROR_EXPECT_SIZE
 };
 
 typedef void (*parseconf_error_callback_t)(void* user, parseconf_error_t error, size_t line, size_t token, const parseconf_token_t* tokens, const char* errstr);
 
 #define PARSECONF_SYNTAX_END \
     {                        \
-        0, 0, 0, 0           \
+        0, 0, 0, 0, 0, 0, 0  \
     }
 typedef struct parseconf_syntax parseconf_syntax_t;
 struct parseconf_syntax {
@@ -145,17 +211,139 @@ struct parseconf_syntax {
     parseconf_token_callback_t    callback;
     const parseconf_token_type_t* syntax;
     const parseconf_syntax_t*     nested;
+    parseconf_batch_callback_t    batch_callback;
+    size_t                        batch_size;
+    parseconf_token_callback_t    remove_callback;
+};
+
+typedef int (*parseconf_check_t)(const parseconf_token_t* tokens, size_t size, const parseconf_syntax_t** syntax, parseconf_error_t* error, size_t* token);
+
+typedef struct parseconf_limits parseconf_limits_t;
+struct parseconf_limits {
+    size_t   line_length, token_length, bytes, statements;
+    uint64_t time;
+};
+
+typedef struct parseconf_stats_keyword parseconf_stats_keyword_t;
+struct parseconf_stats_keyword {
+    const parseconf_syntax_t* syntax;
+    size_t                    calls;
+    uint64_t                  time;
+};
+
+typedef struct parseconf_stats parseconf_stats_t;
+struct parseconf_stats {
+    size_t                     bytes, lines, statements;
+    size_t                     tokens[PARSECONF_TOKEN_TYPES];
+    size_t                     line_peak, buffer_peak;
+    uint64_t                   read_time, tokenize_time, check_time, callback_time;
+    parseconf_stats_keyword_t* keywords;
+    size_t                     keywords_size;
+};
+
+typedef struct parseconf_arena parseconf_arena_t;
+
+int parseconf_arena_new(parseconf_arena_t** arena);
+void parseconf_arena_free(parseconf_arena_t* arena);
+const char* parseconf_arena_strdup(parseconf_arena_t* arena, const parseconf_token_t* token);
+
+typedef struct parseconf_intern parseconf_intern_t;
+
+int parseconf_intern_new(parseconf_intern_t** intern);
+void parseconf_intern_free(parseconf_intern_t* intern);
+size_t parseconf_intern_size(const parseconf_intern_t* intern);
+const char* parseconf_intern_string(const parseconf_intern_t* intern, unsigned int id, size_t* length);
+
+/*
+ * Options of a call, context or stream, a member that is zero is not used.
+ * `threads` is only used by parseconf_file_options(),
+ * parseconf_text_options() and parseconf_dir_options(), contexts and
+ * streams parse in the calling thread and do not accept more than one.
+ */
+
+typedef struct parseconf_options parseconf_options_t;
+struct parseconf_options {
+    parseconf_stats_t*        stats;
+    parseconf_arena_t*        arena;
+    parseconf_intern_t*       intern;
+    const parseconf_limits_t* limits;
+    size_t                    threads;
 };
 
 int parseconf_ulongint(const parseconf_token_t* token, unsigned long int* value, const char** errstr);
 int parseconf_ulonglongint(const parseconf_token_t* token, unsigned long long int* value, const char** errstr);
+int parseconf_int64(const parseconf_token_t* token, int64_t* value, const char** errstr);
+int parseconf_uint64(const parseconf_token_t* token, uint64_t* value, const char** errstr);
+int parseconf_uint32(const parseconf_token_t* token, uint32_t* value, const char** errstr);
+int parseconf_uint16(const parseconf_token_t* token, uint16_t* value, const char** errstr);
 int parseconf_double(const parseconf_token_t* token, double* value, const char** errstr);
 int parseconf_longdouble(const parseconf_token_t* token, long double* value, const char** errstr);
+int parseconf_numbers_u64(const parseconf_token_t* tokens, size_t start, uint64_t* values, size_t count, size_t* failed, const char** errstr);
+int parseconf_numbers_double(const parseconf_token_t* tokens, size_t start, double* values, size_t count, size_t* failed, const char** errstr);
+
+/*
+ * parseconf_file_cached() only uses the cache if the content hash of the
+ * file is the same. parseconf_file_cached_stat() skips hashing when the
+ * size, modification time and inode are the same, which is faster but
+ * replays the old statements of a file rewritten in place with its old
+ * modification time, as touch -r or cp -p do.
+ */
 
 int parseconf_file(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+int parseconf_file_options(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options);
+int parseconf_file_mmap(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+int parseconf_file_cached(void* user, const char* file, const char* cache, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+int parseconf_file_cached_stat(void* user, const char* file, const char* cache, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+int parseconf_file_parallel(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads);
 int parseconf_text(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+int parseconf_text_options(void* user, const char* text, const size_t length, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options);
+int parseconf_dir(void* user, const char* dir, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, size_t threads);
+int parseconf_dir_options(void* user, const char* dir, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, const parseconf_options_t* options);
+void parseconf_stats_free(parseconf_stats_t* stats);
 const char* parseconf_strerror(int errnum);
 
+typedef struct parseconf_reload parseconf_reload_t;
+
+int parseconf_reload_new(parseconf_reload_t** reload);
+void parseconf_reload_free(parseconf_reload_t* reload);
+int parseconf_file_reload(void* user, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, parseconf_reload_t* reload);
+
+typedef struct parseconf_ctx parseconf_ctx_t;
+
+int parseconf_ctx_new(parseconf_ctx_t** ctx, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+void parseconf_ctx_free(parseconf_ctx_t* ctx);
+int parseconf_ctx_options(parseconf_ctx_t* ctx, const parseconf_options_t* options);
+int parseconf_ctx_check(parseconf_ctx_t* ctx, parseconf_check_t check);
+int parseconf_ctx_file(parseconf_ctx_t* ctx, void* user, const char* file);
+int parseconf_ctx_text(parseconf_ctx_t* ctx, void* user, const char* text, const size_t length);
+
+/*
+ * Readers are owned by the caller, free all readers of a watch with
+ * parseconf_watch_reader_free() before freeing the watch
+ */
+
+typedef void* (*parseconf_snapshot_new_t)(void* arg);
+typedef void (*parseconf_snapshot_free_t)(void* arg, void* snapshot);
+
+typedef struct parseconf_watch parseconf_watch_t;
+typedef struct parseconf_watch_reader parseconf_watch_reader_t;
+
+int parseconf_watch_new(parseconf_watch_t** watch, const char* file, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback, parseconf_snapshot_new_t snapshot_new, parseconf_snapshot_free_t snapshot_free, void* arg);
+void parseconf_watch_free(parseconf_watch_t* watch);
+int parseconf_watch_reload(parseconf_watch_t* watch);
+int parseconf_watch_reader_new(parseconf_watch_t* watch, parseconf_watch_reader_t** reader);
+void parseconf_watch_reader_free(parseconf_watch_reader_t* reader);
+void* parseconf_watch_enter(parseconf_watch_reader_t* reader);
+void parseconf_watch_leave(parseconf_watch_reader_t* reader);
+
+typedef struct parseconf_stream parseconf_stream_t;
+
+int parseconf_stream_new(parseconf_stream_t** stream, void* user, const parseconf_syntax_t* syntax, parseconf_error_callback_t error_callback);
+void parseconf_stream_free(parseconf_stream_t* stream);
+int parseconf_stream_options(parseconf_stream_t* stream, const parseconf_options_t* options);
+int parseconf_stream_feed(parseconf_stream_t* stream, const char* data, size_t length);
+int parseconf_stream_finish(parseconf_stream_t* stream);
+
 #ifdef __cplusplus
 }
 #endif